@@ -4,9 +4,13 @@
 #include <unistd.h>
 #include <string.h>
 #include <stdbool.h>
-#include <glib-2.0/gmodule.h>
+#include <inttypes.h>
 #include <bsd/stdlib.h>
 
+#include "file.h"
+#include "repeat.h"
+#include "utils.h"
+
 int main(int argc, char *argv[])
 {
     if (argc < 2) {
@@ -15,51 +19,26 @@ int main(int argc, char *argv[])
     }
 
     char *filename = argv[1];
-    FILE *fp = fopen(filename, "r");
-    if (NULL == fp) {
-        printf("Could not open %s: %s\n", filename, strerror(errno));
+    size_t count = 0;
+    int64_t *vals = file_get_numbers(filename, &count);
+    if (NULL == vals) {
+        printf("Could not read numbers from %s\n", filename);
         exit(EXIT_FAILURE);
     }
 
-    char *line = NULL;
-    size_t len = 0;
-    ssize_t read = 0;
-
-    int linecount = 0;
-    
-    while ((read = getline(&line, &len, fp)) != -1) {
-        linecount++;
-    }
-
-    rewind(fp);
-
-    GHashTable *ht = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, NULL);
-    int *vals = calloc(linecount, sizeof(int));
-    
-    int sum = 0;
-    int i = 0;
-    while ((read = getline(&line, &len, fp)) != -1) {
-        int val  = strtol(line, NULL, 0);
-        sum += val;
-        vals[i++] = val;
-        if (g_hash_table_contains(ht, GINT_TO_POINTER(sum))) {
-            printf("Found it: %d\n", sum);
-            return EXIT_SUCCESS;
-        }
-        g_hash_table_add(ht, GINT_TO_POINTER(sum));
+    int64_t frequency = 0;
+    for (size_t i = 0; i < count; ++i) {
+        frequency += vals[i];
     }
+    printf("Resulting frequency: %" PRId64 "\n", frequency);
 
-    bool found = false;
-    while (!found) {
-        for (i = 0; i < linecount; ++i) {
-            sum += vals[i];
-            if (g_hash_table_contains(ht, GINT_TO_POINTER(sum))) {
-                printf("Found it: %d\n", sum);
-                return EXIT_SUCCESS;
-            }
-            g_hash_table_add(ht, GINT_TO_POINTER(sum));
-        }   
+    int64_t repeated = 0;
+    if (repeat_find_first(vals, count, REPEAT_AUTO, &repeated)) {
+        printf("Found it: %" PRId64 "\n", repeated);
+    } else {
+        printf("No frequency is ever reached twice\n");
     }
 
+    free(vals);
     return EXIT_SUCCESS;
 }
@@ -6,71 +6,81 @@
 #include <bsd/stdlib.h>
 
 #include "file.h"
+#include "neardup.h"
+#include "parse.h"
+#include "text.h"
 #include "utils.h"
 
 void count_letters(line_t *line, bool *counts2, bool *counts3)
 {
-    unsigned long num2s = 0, num3s=0;
-    unsigned long char_counts[26] = {0};
-    for (size_t i = 0; i < line->len; ++i) {
-        int index = line->str[i] - 'a';
-        unsigned long oldcnt = char_counts[index];
-        unsigned long newcnt = char_counts[index] + 1;
-        if (oldcnt == 2 && newcnt > 2) {
-            num2s--;
-        } else if (oldcnt == 3 && newcnt > 3) {
-            num3s--;
-        } 
-        
-        if (newcnt == 2) {
-            num2s++;
-        } else if (newcnt == 3) {
-            num3s++;
-        }
-
-        char_counts[index] = newcnt;
-    }
-
-    if (num2s > 0) {
+    uint8_t counts[TEXT_LETTER_SLOTS];
+    text_count_letters(line->str, line->len, counts);
+    if (text_letters_with_count(counts, 2) != 0) {
         *counts2 = true;
     }
 
-    if (num3s > 0) {
+    if (text_letters_with_count(counts, 3) != 0) {
         *counts3 = true;
     }
 }
 
-int hamming_distance(line_t *l1, line_t *l2, char *outstr)
+// Prints the letters the first matching pair has in common and stops there.
+static bool print_common(size_t a, size_t b, size_t distance, void *ctx)
 {
-    int hd = 0;
-    int out_index = 0;
-    for (size_t i = 0; i < l1->len; ++i) {
-        if (l1->str[i] != l2->str[i]) {
-            hd++;
-        } else {
-            outstr[out_index++] = l1->str[i];
-        }
+    file_t *file = ctx;
+    line_t *l1 = file_get_line(file, a);
+    line_t *l2 = file_get_line(file, b);
+    if (distance != 1) {
+        return true;
     }
 
-    return hd;
+    char outstr[line_length(l1) + 1];
+    text_common(l1->str, l2->str, line_length(l1), outstr);
+    printf("%s\n", outstr);
+    return false;
+}
+
+static void usage(void)
+{
+    printf("usage: %s [-t threads] [input]\n", getprogname());
 }
 
 int main(int argc, char *argv[])
 {
-    if (argc < 2) {
-        printf("usage: %s [input]\n", getprogname());
+    int opt;
+    while ((opt = getopt(argc, argv, "t:")) != -1) {
+        switch (opt) {
+            case 't': {
+                // Threads used to load the IDs for the near-duplicate search
+                uint64_t threads = 0;
+                const char *s = optarg;
+                if (!parse_uint64(&s, optarg + strlen(optarg), &threads) || *s != '\0' || threads == 0) {
+                    usage();
+                    return EXIT_FAILURE;
+                }
+                file_set_threads(threads);
+                break;
+            }
+            default:
+                usage();
+                return EXIT_FAILURE;
+        }
+    }
+
+    if (optind >= argc) {
+        usage();
         return EXIT_FAILURE;
     }
+    const char *filename = argv[optind];
 
-    file_t *file = file_get_lines(argv[1], NULL, NULL, NULL);
-    DIE_IF((file == NULL), "Could not read lines from %s\n", argv[1]);
+    // Both parts run over the one line table, so the file is read once.
+    file_t *file = file_get_lines(filename, NULL, NULL);
+    DIE_IF((file == NULL), "Could not read lines from %s\n", filename);
 
     uint64_t num2s = 0, num3s = 0;
-    line_t *line = NULL;
-    for (uint32_t i = 0; i < file_line_count(file); ++i) {
-        line = file_get_line(file, i);
+    for (size_t i = 0; i < file_line_count(file); ++i) {
         bool count2 = false, count3 = false;
-        count_letters(line, &count2, &count3);
+        count_letters(file_get_line(file, i), &count2, &count3);
         if (count2) {
             num2s++;
         }
@@ -82,24 +92,9 @@ int main(int argc, char *argv[])
 
     printf("result: (%lu * %lu) =  %lu\n", num2s, num3s, (num2s * num3s));
 
-    size_t line_size = line_length(file_get_line(file, 0));
-    char outstr[line_size];
-    for (uint32_t i = 0; i < file_line_count(file); ++i) {
-        line_t *l1 = file_get_line(file, i);
-        for (uint32_t j = 0; j < file_line_count(file); ++j) {
-            if (j != i) {
-                line_t *l2 = file_get_line(file, j);
-                memset(outstr, 0, line_size);
-                int hd = hamming_distance(l1, l2, outstr);
-                if (hd == 1) {
-                    printf("%s\n", outstr);
-                    goto out;
-                    return 0;
-                }
-            }
-        }
-    }
+    // The two box IDs differ by exactly one character, so the index only
+    // has to find the first pair at distance 1.
+    neardup_find(file->lines, file_line_count(file), 1, NEARDUP_AUTO, print_common, file);
 
-out:
     file_free(file);
 }
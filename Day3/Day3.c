@@ -6,56 +6,82 @@
 #include <bsd/stdlib.h>
 
 #include "file.h"
+#include "grid.h"
+#include "cover.h"
+#include "sweep.h"
+#include "parallel.h"
+#include "parse.h"
+#include "stream.h"
+#include "table.h"
 #include "utils.h"
 
-typedef struct claim
-{
-    uint32_t id;
-    int from_left;
-    int from_top;
-    int width;
-    int height;
-} claim_t;
+enum {
+    CLAIM_ID = 0,
+    CLAIM_FROM_LEFT,
+    CLAIM_FROM_TOP,
+    CLAIM_WIDTH,
+    CLAIM_HEIGHT,
+    CLAIM_COLUMNS,
+};
 
-bool parse_claim(line_t *line)
-{
-    char *s = line_string(line);
-    claim_t *c = calloc(1, sizeof(claim_t));
-    sscanf(s, "#%u @ %u,%u: %ux%u", &c->id, &c->from_left, &c->from_top, &c->width, &c->height);
-    line->extra = c;
-    return true;
-}
+static const size_t claim_widths[CLAIM_COLUMNS] = {
+    [CLAIM_ID] = sizeof(uint32_t),
+    [CLAIM_FROM_LEFT] = sizeof(uint32_t),
+    [CLAIM_FROM_TOP] = sizeof(uint32_t),
+    [CLAIM_WIDTH] = sizeof(uint32_t),
+    [CLAIM_HEIGHT] = sizeof(uint32_t),
+};
 
-void free_claim(line_t *line)
+// "#<id> @ <from_left>,<from_top>: <width>x<height>", appended to claims as
+// a new row. Nothing is appended if the line doesn't parse.
+bool parse_claim(const char *s, size_t len, table_t *claims)
 {
-    free(line->extra);
+    const char *end = s + len;
+    uint32_t id = 0, from_left = 0, from_top = 0, width = 0, height = 0;
+    if (!parse_next_uint32(&s, end, &id) || !parse_next_uint32(&s, end, &from_left) ||
+        !parse_next_uint32(&s, end, &from_top) || !parse_next_uint32(&s, end, &width) ||
+        !parse_next_uint32(&s, end, &height)) {
+        return false;
+    }
+
+    size_t row = table_append(claims);
+    TABLE_AT(claims, uint32_t, CLAIM_ID, row) = id;
+    TABLE_AT(claims, uint32_t, CLAIM_FROM_LEFT, row) = from_left;
+    TABLE_AT(claims, uint32_t, CLAIM_FROM_TOP, row) = from_top;
+    TABLE_AT(claims, uint32_t, CLAIM_WIDTH, row) = width;
+    TABLE_AT(claims, uint32_t, CLAIM_HEIGHT, row) = height;
+    return true;
 }
 
 typedef struct fabric
 {
     uint32_t width;
     uint32_t height;
-    uint32_t **matrix;
+    grid_t *grid;
 } fabric_t;
 
 #define FABRIC_SIDE_MIN (1000)
 #define MAX(__a, __b) (((__a) > (__b)) ? (__a) : (__b)) 
 #define MIN(__a, __b) (((__a) < (__b)) ? (__a) : (__b)) 
 
+// Units only ever go EMPTY -> TAKEN -> OVERLAP, so they fit in 2-bit cells:
+// the low bit of a cell is TAKEN and the high bit is OVERLAP.
 #define UNIT_EMPTY 0
 #define UNIT_TAKEN 1
 #define UNIT_OVERLAP 2
-// matrix[0]
-// matric[1]
+
+#define UNIT_TAKEN_BITS (0x5555555555555555ULL)
 
 fabric_t *fabric_create(uint32_t min_x, uint32_t min_y)
 {
     fabric_t *fabric = calloc(1, sizeof(fabric_t));
+    VALIDATE_PTR_OR_RETURN(fabric, NULL);
     fabric->width = MAX(min_x, FABRIC_SIDE_MIN);
     fabric->height = MAX(min_y, FABRIC_SIDE_MIN);
-    fabric->matrix = calloc(fabric->height, sizeof(uint32_t *));
-    for (uint32_t i = 0; i < fabric->height; ++i) {
-        fabric->matrix[i] = calloc(fabric->width, sizeof(uint32_t));
+    fabric->grid = grid_create(fabric->width, fabric->height, GRID_CELL_2);
+    if (fabric->grid == NULL) {
+        free(fabric);
+        return NULL;
     }
 
     return fabric;
@@ -63,82 +89,393 @@ fabric_t *fabric_create(uint32_t min_x, uint32_t min_y)
 
 void fabric_free(fabric_t *fabric)
 {
-    if (fabric && fabric->matrix) {
-        for (uint32_t i = 0; i < fabric->height; ++i) {
-            free(fabric->matrix[i]);
-        }
-        free(fabric->matrix);
+    if (fabric) {
+        grid_free(fabric->grid);
         free(fabric);
     }
 }
 
-void fabric_claim_area(fabric_t *fabric, claim_t *claim)
+// Moves every unit under mask one step along EMPTY -> TAKEN -> OVERLAP.
+static inline uint64_t fabric_claim_word(uint64_t word, uint64_t mask)
 {
-    uint32_t y_end = claim->from_top + claim->height;
-    uint32_t x_end = claim->from_left + claim->width;
-    for (uint32_t y = claim->from_top; y < y_end; ++y) {
-        for (uint32_t x = claim->from_left; x < x_end; ++x) {
-            uint32_t *valuep = &fabric->matrix[y][x];
-            switch (*valuep) {
-                case UNIT_EMPTY:
-                    *valuep = UNIT_TAKEN;
-                    break;
-                case UNIT_TAKEN:
-                    *valuep = UNIT_OVERLAP;
-                    break;
-                default:
-                    break;
-            }
+    uint64_t used = (word | (word >> 1)) & UNIT_TAKEN_BITS;
+    uint64_t next = (used << 1) | (~used & UNIT_TAKEN_BITS);
+    return (word & ~mask) | (next & mask);
+}
+
+void fabric_claim_area(fabric_t *fabric, uint32_t from_left, uint32_t from_top, uint32_t width, uint32_t height)
+{
+    uint32_t y_end = from_top + height;
+    uint32_t x_end = from_left + width;
+    if (width == 0) {
+        return;
+    }
+
+    size_t first = from_left / GRID_CELLS_PER_WORD2;
+    size_t last = (x_end - 1) / GRID_CELLS_PER_WORD2;
+    uint64_t first_mask = grid_span_mask2(from_left % GRID_CELLS_PER_WORD2, GRID_CELLS_PER_WORD2);
+    uint64_t last_mask = grid_span_mask2(0, ((x_end - 1) % GRID_CELLS_PER_WORD2) + 1);
+    for (uint32_t y = from_top; y < y_end; ++y) {
+        uint64_t *row = GRID_ROW(fabric->grid, uint64_t, y);
+        if (first == last) {
+            row[first] = fabric_claim_word(row[first], first_mask & last_mask);
+            continue;
         }
+
+        row[first] = fabric_claim_word(row[first], first_mask);
+        for (size_t w = first + 1; w < last; ++w) {
+            row[w] = fabric_claim_word(row[w], ~0ULL);
+        }
+        row[last] = fabric_claim_word(row[last], last_mask);
     }
 }
 
-bool fabric_check_claim(fabric_t *fabric, claim_t *claim)
+bool fabric_check_claim(fabric_t *fabric, uint32_t from_left, uint32_t from_top, uint32_t width, uint32_t height)
 {
-    uint32_t y_end = claim->from_top + claim->height;
-    uint32_t x_end = claim->from_left + claim->width;
-    for (uint32_t y = claim->from_top; y < y_end; ++y) {
-        for (uint32_t x = claim->from_left; x < x_end; ++x) {
-            uint32_t value = fabric->matrix[y][x];
-            if (value == UNIT_OVERLAP) {
-                return false;
-            }
+    uint32_t y_end = from_top + height;
+    uint32_t x_end = from_left + width;
+    for (uint32_t y = from_top; y < y_end; ++y) {
+        if (grid_any_eq(fabric->grid, y, from_left, x_end, UNIT_OVERLAP)) {
+            return false;
         }
     }
     return true;
 }
 
-uint32_t fabric_compute_overlap(fabric_t *fabric)
+// Overlapping units in rows [y_begin, y_end)
+uint64_t fabric_compute_overlap_rows(fabric_t *fabric, uint32_t y_begin, uint32_t y_end)
 {
-    uint32_t overlap = 0;
-    for (uint32_t y = 0; y < fabric->height; ++y) {
-        for (uint32_t x = 0; x < fabric->width; ++x) {
-            if (fabric->matrix[y][x] == UNIT_OVERLAP) {
-                overlap++;
-            }
-        }
+    uint64_t overlap = 0;
+    for (uint32_t y = y_begin; y < y_end; ++y) {
+        overlap += grid_count_eq(fabric->grid, y, 0, fabric->width, UNIT_OVERLAP);
     }
     return overlap;
 }
 
+uint64_t fabric_compute_overlap(fabric_t *fabric)
+{
+    return fabric_compute_overlap_rows(fabric, 0, fabric->height);
+}
+
+// Painting is split into bands of whole rows about this big, so a band
+// stays in cache while all of its claims are painted and checked.
+#define FABRIC_TILE_BYTES (128 * 1024)
+
+// The fabric cut into horizontal tiles, with every claim binned into each
+// tile its rows touch. A tile's claims can then be painted and checked
+// without looking at the rest of the fabric, and tiles never share a word.
+typedef struct fabric_tiles
+{
+    fabric_t *fabric;
+    table_t *claims;
+    uint32_t tile_rows;
+    size_t ntiles;
+    size_t *bin_start;
+    uint32_t *bins;
+    uint64_t *overlap;
+    uint8_t *overlapped;
+    size_t next_tile;
+} fabric_tiles_t;
+
+static void fabric_tiles_bin(fabric_tiles_t *tiles)
+{
+    size_t nclaims = table_row_count(tiles->claims);
+    uint32_t *from_top = TABLE_COLUMN(tiles->claims, uint32_t, CLAIM_FROM_TOP);
+    uint32_t *height = TABLE_COLUMN(tiles->claims, uint32_t, CLAIM_HEIGHT);
+
+    // Count the claims per tile, turn the counts into offsets, then fill.
+    size_t *start = calloc(tiles->ntiles + 1, sizeof(size_t));
+    DIE_IF((start == NULL), "Could not allocate %zu tile bins", tiles->ntiles);
+    for (size_t i = 0; i < nclaims; ++i) {
+        if (height[i] == 0) {
+            continue;
+        }
+        size_t first = from_top[i] / tiles->tile_rows;
+        size_t last = (from_top[i] + height[i] - 1) / tiles->tile_rows;
+        for (size_t t = first; t <= last; ++t) {
+            start[t + 1]++;
+        }
+    }
+    for (size_t t = 0; t < tiles->ntiles; ++t) {
+        start[t + 1] += start[t];
+    }
+
+    uint32_t *bins = malloc(MAX(start[tiles->ntiles], 1) * sizeof(uint32_t));
+    size_t *fill = malloc(tiles->ntiles * sizeof(size_t));
+    DIE_IF((bins == NULL || fill == NULL), "Could not allocate %zu binned claims", start[tiles->ntiles]);
+    memcpy(fill, start, tiles->ntiles * sizeof(size_t));
+    for (size_t i = 0; i < nclaims; ++i) {
+        if (height[i] == 0) {
+            continue;
+        }
+        size_t first = from_top[i] / tiles->tile_rows;
+        size_t last = (from_top[i] + height[i] - 1) / tiles->tile_rows;
+        for (size_t t = first; t <= last; ++t) {
+            bins[fill[t]++] = (uint32_t)i;
+        }
+    }
+
+    free(fill);
+    tiles->bin_start = start;
+    tiles->bins = bins;
+}
+
+// Paints a tile's claims clipped to its rows, then counts its overlap and
+// checks its claims. Every claim touching those rows is in the bin, so the
+// rows are final by the time they're read.
+static void fabric_tile_run(fabric_tiles_t *tiles, size_t tile)
+{
+    fabric_t *fabric = tiles->fabric;
+    uint32_t *from_left = TABLE_COLUMN(tiles->claims, uint32_t, CLAIM_FROM_LEFT);
+    uint32_t *from_top = TABLE_COLUMN(tiles->claims, uint32_t, CLAIM_FROM_TOP);
+    uint32_t *width = TABLE_COLUMN(tiles->claims, uint32_t, CLAIM_WIDTH);
+    uint32_t *height = TABLE_COLUMN(tiles->claims, uint32_t, CLAIM_HEIGHT);
+    uint32_t y_begin = (uint32_t)(tile * tiles->tile_rows);
+    uint32_t y_end = MIN(y_begin + tiles->tile_rows, fabric->height);
+
+    for (size_t b = tiles->bin_start[tile]; b < tiles->bin_start[tile + 1]; ++b) {
+        uint32_t i = tiles->bins[b];
+        uint32_t top = MAX(from_top[i], y_begin);
+        uint32_t bottom = MIN(from_top[i] + height[i], y_end);
+        fabric_claim_area(fabric, from_left[i], top, width[i], bottom - top);
+    }
+
+    tiles->overlap[tile] = fabric_compute_overlap_rows(fabric, y_begin, y_end);
+
+    for (size_t b = tiles->bin_start[tile]; b < tiles->bin_start[tile + 1]; ++b) {
+        uint32_t i = tiles->bins[b];
+        uint32_t top = MAX(from_top[i], y_begin);
+        uint32_t bottom = MIN(from_top[i] + height[i], y_end);
+        if (!fabric_check_claim(fabric, from_left[i], top, width[i], bottom - top)) {
+            __atomic_store_n(&tiles->overlapped[i], 1, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+static void fabric_tiles_worker(void *ctx, size_t index, size_t count)
+{
+    fabric_tiles_t *tiles = ctx;
+    size_t tile;
+    while ((tile = __atomic_fetch_add(&tiles->next_tile, 1, __ATOMIC_RELAXED)) < tiles->ntiles) {
+        fabric_tile_run(tiles, tile);
+    }
+}
+
+typedef enum
+{
+    // Count coverage with a difference array and summed-area table
+    SOLVE_SUMS = 0,
+    // Paint every claim unit by unit onto a 2-bit fabric
+    SOLVE_PAINT,
+    // Sweep over the claims' edges; no grid at all
+    SOLVE_SWEEP,
+} solve_mode_t;
+
+// Dense modes fall back to the sweep when their grid would be bigger than
+// this many MiB (-b).
+#define SOLVE_DEFAULT_BUDGET_MB (1024)
+
+// Whether the grid of a dense mode for a furthest_x x furthest_y box fits in
+// budget_mb MiB. A size too big to even compute doesn't fit.
+static bool solve_grid_fits(solve_mode_t mode, uint64_t furthest_x, uint64_t furthest_y, uint64_t budget_mb)
+{
+    uint64_t bytes = 0;
+    if (mode == SOLVE_PAINT) {
+        if (__builtin_mul_overflow(MAX(furthest_x, FABRIC_SIDE_MIN), MAX(furthest_y, FABRIC_SIDE_MIN), &bytes)) {
+            return false;
+        }
+        bytes /= 4;
+    } else if (__builtin_mul_overflow(furthest_x + 1, furthest_y + 1, &bytes) || __builtin_mul_overflow(bytes, sizeof(uint32_t), &bytes)) {
+        return false;
+    }
+
+    // A budget too big to count in bytes is no limit at all.
+    uint64_t budget = 0;
+    if (__builtin_mul_overflow(budget_mb, 1024 * 1024, &budget)) {
+        return true;
+    }
+    return (bytes <= budget);
+}
+
+static void print_no_overlap(table_t *claims, size_t claim)
+{
+    printf("Claim %u doesn't have any overlap\n", TABLE_AT(claims, uint32_t, CLAIM_ID, claim));
+}
+
+// Returns false, having done nothing, if the fabric can't be created.
+bool solve_paint(table_t *claims, uint32_t furthest_x, uint32_t furthest_y, size_t threads)
+{
+    size_t nclaims = table_row_count(claims);
+    fabric_t *fabric = fabric_create(furthest_x, furthest_y);
+    if (fabric == NULL) {
+        ERR("Could not create a %u x %u fabric", furthest_x, furthest_y);
+        return false;
+    }
+
+    fabric_tiles_t tiles = {
+        .fabric = fabric,
+        .claims = claims,
+        .tile_rows = (uint32_t)MAX(FABRIC_TILE_BYTES / fabric->grid->stride, 1),
+        .next_tile = 0,
+    };
+    tiles.ntiles = (fabric->height + tiles.tile_rows - 1) / tiles.tile_rows;
+    tiles.overlap = calloc(tiles.ntiles, sizeof(uint64_t));
+    tiles.overlapped = calloc(MAX(nclaims, 1), sizeof(uint8_t));
+    DIE_IF((tiles.overlap == NULL || tiles.overlapped == NULL), "Could not allocate %zu tiles", tiles.ntiles);
+    fabric_tiles_bin(&tiles);
+
+    parallel_for(MIN(MAX(threads, 1), tiles.ntiles), fabric_tiles_worker, &tiles);
+
+    uint64_t overlap = 0;
+    for (size_t t = 0; t < tiles.ntiles; ++t) {
+        overlap += tiles.overlap[t];
+    }
+    printf("Total Overlap: %lu\n", overlap);
+
+    for (size_t i = 0; i < nclaims; ++i) {
+        if (!tiles.overlapped[i]) {
+            print_no_overlap(claims, i);
+            break;
+        }
+    }
+
+    free(tiles.bins);
+    free(tiles.bin_start);
+    free(tiles.overlapped);
+    free(tiles.overlap);
+    fabric_free(fabric);
+    return true;
+}
+
+// O(claims + width * height) however large the claims are. Returns false,
+// having done nothing, if the coverage grid can't be created.
+bool solve_sums(table_t *claims, uint32_t furthest_x, uint32_t furthest_y)
+{
+    uint32_t *from_left = TABLE_COLUMN(claims, uint32_t, CLAIM_FROM_LEFT);
+    uint32_t *from_top = TABLE_COLUMN(claims, uint32_t, CLAIM_FROM_TOP);
+    uint32_t *width = TABLE_COLUMN(claims, uint32_t, CLAIM_WIDTH);
+    uint32_t *height = TABLE_COLUMN(claims, uint32_t, CLAIM_HEIGHT);
+    size_t nclaims = table_row_count(claims);
+    cover_t *cover = cover_create(furthest_x, furthest_y);
+    if (cover == NULL) {
+        ERR("Could not create a %u x %u coverage grid", furthest_x, furthest_y);
+        return false;
+    }
+
+    for (size_t i = 0; i < nclaims; ++i) {
+        cover_add(cover, from_left[i], from_top[i], width[i], height[i]);
+    }
+    cover_resolve(cover);
+
+    printf("Total Overlap: %lu\n", cover_overlap_area(cover));
+
+    for (size_t i = 0; i < nclaims; ++i) {
+        if (!cover_overlaps(cover, from_left[i], from_top[i], width[i], height[i])) {
+            print_no_overlap(claims, i);
+            break;
+        }
+    }
+
+    cover_free(cover);
+    return true;
+}
+
+// O(claims log claims) time and O(claims) memory, whatever the coordinates
+void solve_sweep(table_t *claims)
+{
+    size_t nclaims = table_row_count(claims);
+    bool *overlapped = malloc(nclaims * sizeof(bool));
+    DIE_IF((nclaims != 0 && overlapped == NULL), "Could not allocate flags for %zu claims", nclaims);
+
+    uint64_t overlap = sweep_overlap(TABLE_COLUMN(claims, uint32_t, CLAIM_FROM_LEFT),
+                                     TABLE_COLUMN(claims, uint32_t, CLAIM_FROM_TOP),
+                                     TABLE_COLUMN(claims, uint32_t, CLAIM_WIDTH),
+                                     TABLE_COLUMN(claims, uint32_t, CLAIM_HEIGHT),
+                                     nclaims, overlapped);
+    printf("Total Overlap: %lu\n", overlap);
+
+    for (size_t i = 0; i < nclaims; ++i) {
+        if (!overlapped[i]) {
+            print_no_overlap(claims, i);
+            break;
+        }
+    }
+
+    free(overlapped);
+}
+
+static void usage(void)
+{
+    printf("usage: %s [-m sums|paint|sweep] [-b budget_mb] [-t threads] [input]\n", getprogname());
+}
+
 int main(int argc, char *argv[])
 {
-    if (argc < 2) {
-        printf("usage: %s [input]\n", getprogname());
+    solve_mode_t mode = SOLVE_SUMS;
+    uint64_t budget_mb = SOLVE_DEFAULT_BUDGET_MB;
+    uint64_t threads = parallel_default_threads();
+    int opt;
+    while ((opt = getopt(argc, argv, "m:b:t:")) != -1) {
+        switch (opt) {
+            case 'm':
+                if (strcmp(optarg, "sums") == 0) {
+                    mode = SOLVE_SUMS;
+                } else if (strcmp(optarg, "paint") == 0) {
+                    mode = SOLVE_PAINT;
+                } else if (strcmp(optarg, "sweep") == 0) {
+                    mode = SOLVE_SWEEP;
+                } else {
+                    usage();
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'b': {
+                const char *s = optarg;
+                if (!parse_uint64(&s, optarg + strlen(optarg), &budget_mb) || *s != '\0') {
+                    usage();
+                    return EXIT_FAILURE;
+                }
+                break;
+            }
+            case 't': {
+                const char *s = optarg;
+                if (!parse_uint64(&s, optarg + strlen(optarg), &threads) || *s != '\0' || threads == 0) {
+                    usage();
+                    return EXIT_FAILURE;
+                }
+                break;
+            }
+            default:
+                usage();
+                return EXIT_FAILURE;
+        }
+    }
+
+    if (optind >= argc) {
+        usage();
         return EXIT_FAILURE;
     }
+    const char *filename = argv[optind];
+
+    table_t *claims = table_create(CLAIM_COLUMNS, claim_widths);
+    DIE_IF((claims == NULL), "Could not create claim table");
+    stream_t *stream = stream_open(filename, STREAM_DEFAULT_CHUNK_SIZE);
+    DIE_IF((stream == NULL), "Could not open %s\n", filename);
+
+    // Claims are streamed into the table and the bounding box is worked out
+    // on the way, so the input text is never held in memory as a whole.
+    uint64_t furthest_x = 0;
+    uint64_t furthest_y = 0;
+    line_t line;
+    while (stream_next_line(stream, &line)) {
+        if (!parse_claim(line_string(&line), line_length(&line), claims)) {
+            continue;
+        }
 
-    file_t *file = file_get_lines(argv[1], parse_claim, free_claim, NULL);
-    DIE_IF((file == NULL), "Could not read lines from %s\n", argv[1]);
+        size_t row = table_row_count(claims) - 1;
 
-    int furthest_x = 0;
-    int furthest_y = 0;
-    line_t *line = NULL;
-    size_t i = 0;
-    file_for_each_line(file, line, i) {
-        claim_t *claim = line_extra_data(line);
-        int x = claim->from_left + claim->width;
-        int y = claim->from_top + claim->height;
+        uint64_t x = (uint64_t)TABLE_AT(claims, uint32_t, CLAIM_FROM_LEFT, row) + TABLE_AT(claims, uint32_t, CLAIM_WIDTH, row);
+        uint64_t y = (uint64_t)TABLE_AT(claims, uint32_t, CLAIM_FROM_TOP, row) + TABLE_AT(claims, uint32_t, CLAIM_HEIGHT, row);
         if (x > furthest_x) {
             furthest_x = x;
         }
@@ -147,27 +484,29 @@ int main(int argc, char *argv[])
             furthest_y = y;
         }
     }
-    fabric_t *fabric = fabric_create(furthest_x, furthest_y);
+    stream_close(stream);
 
-    file_for_each_line(file, line, i) {
-        claim_t *claim = line_extra_data(line);   
-        fabric_claim_area(fabric, claim);
+    // Far-flung coordinates would need a huge grid (or one too wide for
+    // 32-bit sides), so those go to the sweep instead.
+    if (mode != SOLVE_SWEEP) {
+        if (furthest_x >= UINT32_MAX || furthest_y >= UINT32_MAX || !solve_grid_fits(mode, furthest_x, furthest_y, budget_mb)) {
+            mode = SOLVE_SWEEP;
+        }
     }
 
-    uint32_t overlap = fabric_compute_overlap(fabric);
-    printf("Total Overlap: %u\n", overlap);
-
-    file_for_each_line(file, line, i) {
-        claim_t *claim = line_extra_data(line);   
-        bool no_overlap = fabric_check_claim(fabric, claim);
-        if (no_overlap) {
-            printf("Claim %u doesn't have any overlap\n", claim->id);
-            break;
-        }
+    // A grid that's within budget can still fail to allocate, and then the
+    // sweep takes over too.
+    bool solved = false;
+    if (mode == SOLVE_PAINT) {
+        solved = solve_paint(claims, (uint32_t)furthest_x, (uint32_t)furthest_y, threads);
+    } else if (mode == SOLVE_SUMS) {
+        solved = solve_sums(claims, (uint32_t)furthest_x, (uint32_t)furthest_y);
+    }
+    if (!solved) {
+        solve_sweep(claims);
     }
 
-    fabric_free(fabric);
-    file_free(file);
+    table_free(claims);
 
     return 0;
 }
@@ -1,4 +1,3 @@
-#include <time.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -7,6 +6,10 @@
 #include <bsd/stdlib.h>
 
 #include "file.h"
+#include "extsort.h"
+#include "intmap.h"
+#include "parse.h"
+#include "stream.h"
 #include "utils.h"
 
 typedef enum
@@ -16,183 +19,286 @@ typedef enum
     EVENT_WAKEUP,
 } event_type_t;
 
+// key is the packed timestamp, which is also the sort key and holds the
+// minute in its low bits.
 typedef struct event
 {
+    uint64_t key;
     uint32_t guard_id;
-    event_type_t type;
-    struct tm datetime;    
-    time_t time;
+    uint8_t type;
 } event_t;
 
-typedef struct guard_stats
+// Events go through the external sort as 13-byte records with no padding:
+// key, guard ID, type.
+#define EVENT_RECORD_SIZE (13)
+#define EVENT_RECORD_GUARD_OFFSET (8)
+#define EVENT_RECORD_TYPE_OFFSET (12)
+
+static inline void event_pack(const event_t *event, uint8_t *record)
 {
-    uint32_t guard_id;
-    uint32_t most_seen_minute;
-    uint32_t minutes[60];
-    uint32_t total_minutes_asleep;
-} guard_stats_t;
+    memcpy(record, &event->key, sizeof(event->key));
+    memcpy(record + EVENT_RECORD_GUARD_OFFSET, &event->guard_id, sizeof(event->guard_id));
+    record[EVENT_RECORD_TYPE_OFFSET] = event->type;
+}
 
-typedef struct minute_stats
+static inline void event_unpack(const uint8_t *record, event_t *event)
 {
-    uint32_t guard_id;
-    uint32_t times_asleep;
-} minute_stats_t;
+    memcpy(&event->key, record, sizeof(event->key));
+    memcpy(&event->guard_id, record + EVENT_RECORD_GUARD_OFFSET, sizeof(event->guard_id));
+    event->type = record[EVENT_RECORD_TYPE_OFFSET];
+}
+
+static inline uint32_t event_minute(uint64_t key)
+{
+    return PARSE_TIMESTAMP_MINUTE(key);
+}
 
-uint32_t highest_guard_id = 0;
+#define MINUTES_PER_HOUR (60)
+#define GUARDS_INITIAL_CAPACITY (64)
 
-bool parse_event(line_t *line)
+// Guards are numbered densely in the order they first show up, through a
+// hash of their IDs, so memory follows the number of guards rather than the
+// largest ID. Each guard's per-minute sleep histogram is one row of a
+// single contiguous block.
+typedef struct guard_registry
 {
-    event_t *event = calloc(1, sizeof(event_t));
-    char *s = line_string(line);
-    char *event_str = NULL;
-    sscanf(s, "[%d-%d-%d %02d:%02d] ", &event->datetime.tm_year, &event->datetime.tm_mon, &event->datetime.tm_mday, &event->datetime.tm_hour, &event->datetime.tm_min);
-    event->datetime.tm_isdst = 1;
-    event->datetime.tm_year = 2018 - 1900;
-    event->datetime.tm_mon--;
-    event->time = timegm(&event->datetime);
-    char *leftbracket = strchr(s, ']');
-    event_str = leftbracket + 2;
-    if (!strcmp(event_str, "falls asleep")) {
-        event->type = EVENT_FALL_ASLEEP;
-    } else if (!strcmp(event_str, "wakes up")) {
-        event->type = EVENT_WAKEUP;
-    } else {
-        event->type = EVENT_BEGIN_SHIFT;
-        sscanf(event_str, "Guard #%u begins shift", &event->guard_id);
-        if (event->guard_id > highest_guard_id) {
-            highest_guard_id = event->guard_id;
+    intmap_t *index;
+    uint32_t *ids;
+    uint32_t *total_asleep;
+    uint16_t (*minutes)[MINUTES_PER_HOUR];
+    size_t count;
+    size_t capacity;
+} guard_registry_t;
+
+guard_registry_t *guard_registry_create(void)
+{
+    guard_registry_t *guards = calloc(1, sizeof(guard_registry_t));
+    VALIDATE_PTR_OR_RETURN(guards, NULL);
+    guards->index = intmap_create(GUARDS_INITIAL_CAPACITY);
+    if (guards->index == NULL) {
+        free(guards);
+        return NULL;
+    }
+    return guards;
+}
+
+void guard_registry_free(guard_registry_t *guards)
+{
+    if (guards) {
+        intmap_free(guards->index);
+        free(guards->ids);
+        free(guards->total_asleep);
+        free(guards->minutes);
+        free(guards);
+    }
+}
+
+// Dense index of guard_id, adding it with an empty histogram if it's new
+size_t guard_registry_lookup(guard_registry_t *guards, uint32_t guard_id)
+{
+    bool found = false;
+    size_t index = intmap_insert(guards->index, guard_id, (uint32_t)guards->count, &found);
+    if (found) {
+        return index;
+    }
+
+    if (guards->count == guards->capacity) {
+        size_t capacity = guards->capacity ? (2 * guards->capacity) : GUARDS_INITIAL_CAPACITY;
+        uint32_t *ids = realloc(guards->ids, capacity * sizeof(uint32_t));
+        DIE_IF((ids == NULL), "Could not grow guard registry to %zu guards", capacity);
+        guards->ids = ids;
+        uint32_t *total_asleep = realloc(guards->total_asleep, capacity * sizeof(uint32_t));
+        DIE_IF((total_asleep == NULL), "Could not grow guard registry to %zu guards", capacity);
+        guards->total_asleep = total_asleep;
+        uint16_t (*minutes)[MINUTES_PER_HOUR] = realloc(guards->minutes, capacity * sizeof(guards->minutes[0]));
+        DIE_IF((minutes == NULL), "Could not grow guard registry to %zu guards", capacity);
+        guards->minutes = minutes;
+        guards->capacity = capacity;
+    }
+
+    guards->ids[index] = guard_id;
+    guards->total_asleep[index] = 0;
+    memset(guards->minutes[index], 0, sizeof(guards->minutes[index]));
+    guards->count++;
+    return index;
+}
+
+// Earliest minute with the highest count in a histogram row
+uint32_t guard_most_seen_minute(const uint16_t minutes[MINUTES_PER_HOUR])
+{
+    uint32_t best = 0;
+    for (uint32_t m = 1; m < MINUTES_PER_HOUR; ++m) {
+        if (minutes[m] > minutes[best]) {
+            best = m;
         }
     }
-    
-    line->extra = event;
-    return true;
+    return best;
 }
 
-void free_event(line_t *line)
+// "[YYYY-MM-DD HH:MM] <falls asleep|wakes up|Guard #<id> begins shift>"
+bool parse_event(const char *s, size_t len, event_t *event)
 {
-    free(line->extra);
+    const char *end = s + len;
+    parse_timestamp_t ts;
+    uint64_t guard_id = 0;
+    event_type_t type = EVENT_BEGIN_SHIFT;
+    if (!parse_timestamp(&s, end, &ts) || !parse_match(&s, end, " ")) {
+        return false;
+    }
+
+    if (parse_match(&s, end, "falls asleep")) {
+        type = EVENT_FALL_ASLEEP;
+    } else if (parse_match(&s, end, "wakes up")) {
+        type = EVENT_WAKEUP;
+    } else if (parse_match(&s, end, "Guard #") && parse_uint64(&s, end, &guard_id) && guard_id <= UINT32_MAX) {
+        type = EVENT_BEGIN_SHIFT;
+    } else {
+        return false;
+    }
+
+    event->key = parse_timestamp_pack(&ts);
+    event->guard_id = (uint32_t)guard_id;
+    event->type = (uint8_t)type;
+    return true;
 }
 
-char *event_make_string(event_t *event)
+char *event_make_string(event_type_t type, uint32_t guard_id)
 {
     static char buf[1024] = {0};
-    switch (event->type) {
+    switch (type) {
         case EVENT_WAKEUP:
             return "wakes up";
         case EVENT_FALL_ASLEEP:
             return "falls asleep";
         case EVENT_BEGIN_SHIFT:
             memset(buf, 0, sizeof(buf));
-            snprintf(buf, 1024, "Guard #%u begins shift", event->guard_id);
+            snprintf(buf, 1024, "Guard #%u begins shift", guard_id);
             return buf;
         default:
             return "Unknown event?!?!";
     }
 }
 
-int sort_event(const void *a, const void *b)
+uint64_t event_record_key(const void *record, void *ctx)
 {
-    line_t *l1 = *(line_t **)a;
-    line_t *l2 = *(line_t **)b;
-    event_t *e1 = l1->extra;
-    event_t *e2 = l2->extra;
-    time_t t1 = e1->time;
-    time_t t2 = e2->time;
-
-    if (t1 == t2) {
-        return 0;
-    } else if (t1 < t2) {
-        return -1;
-    } else {
-        return 1;
-    }
+    uint64_t key;
+    memcpy(&key, record, sizeof(key));
+    return key;
+}
+
+static void usage(void)
+{
+    printf("usage: %s [-m sort_memory_mb] [input]\n", getprogname());
 }
 
 int main(int argc, char *argv[])
 {
-    if (argc < 2) {
-        printf("usage: %s [input]\n", getprogname());
+    uint64_t memory_mb = EXTSORT_DEFAULT_MEMORY >> 20;
+    int opt;
+    while ((opt = getopt(argc, argv, "m:")) != -1) {
+        switch (opt) {
+            case 'm': {
+                const char *s = optarg;
+                if (!parse_uint64(&s, optarg + strlen(optarg), &memory_mb) || *s != '\0' || memory_mb == 0 || memory_mb > (SIZE_MAX >> 20)) {
+                    usage();
+                    return EXIT_FAILURE;
+                }
+                break;
+            }
+            default:
+                usage();
+                return EXIT_FAILURE;
+        }
+    }
+
+    if (optind >= argc) {
+        usage();
         return EXIT_FAILURE;
     }
+    const char *filename = argv[optind];
 
-    file_t *file = file_get_lines(argv[1], parse_event, free_event, sort_event);
-    DIE_IF((file == NULL), "Could not read lines from %s\n", argv[1]);
+    // Events are streamed in and sorted in runs of at most memory_mb,
+    // spilling to temporary files as needed, then merged straight into the
+    // loop below. Neither the log nor the sorted events are ever held in
+    // memory as a whole.
+    extsort_t *sorter = extsort_create(EVENT_RECORD_SIZE, memory_mb << 20, event_record_key, NULL);
+    DIE_IF((sorter == NULL), "Could not create event sorter");
+    stream_t *stream = stream_open(filename, STREAM_DEFAULT_CHUNK_SIZE);
+    DIE_IF((stream == NULL), "Could not open %s\n", filename);
 
-    line_t *line = NULL;
-    size_t i = 0;
-    file_sort_lines(file);
-    guard_stats_t *stats = calloc(highest_guard_id, sizeof(guard_stats_t));
+    line_t line;
+    while (stream_next_line(stream, &line)) {
+        event_t event;
+        uint8_t record[EVENT_RECORD_SIZE];
+        if (parse_event(line_string(&line), line_length(&line), &event)) {
+            event_pack(&event, record);
+            DIE_IF(!extsort_add(sorter, record), "Could not sort events from %s", filename);
+        }
+    }
+    stream_close(stream);
+    DIE_IF(!extsort_finish(sorter), "Could not sort events from %s", filename);
 
-    uint32_t current_id = 0;
+    guard_registry_t *guards = guard_registry_create();
+    DIE_IF((guards == NULL), "Could not create guard registry");
+
+    size_t current = SIZE_MAX;
     uint32_t fall_asleep = 0;
-    uint32_t wakeup = 0;
-    guard_stats_t *most_sleepy_guard = NULL;
-    minute_stats_t minutes[60];
-    memset((void *)&minutes[0], 0, sizeof(minutes));
-    uint32_t most_seen_minute = -1;
-    uint32_t times_most_seen_minute = 0;
-    file_for_each_line(file, line, i) {
-        event_t *event = line_extra_data(line);
-        switch (event->type) {
+    uint8_t record[EVENT_RECORD_SIZE];
+    while (extsort_next(sorter, record)) {
+        event_t event;
+        event_unpack(record, &event);
+        switch (event.type) {
             case EVENT_BEGIN_SHIFT:
-            {
-                current_id = event->guard_id - 1;
-                stats[current_id].guard_id = event->guard_id;
-                if (most_sleepy_guard == NULL) {
-                    most_sleepy_guard = &stats[current_id];
-                }
+                current = guard_registry_lookup(guards, event.guard_id);
                 break;
-            }
             case EVENT_FALL_ASLEEP:
-            {
-                fall_asleep = event->datetime.tm_min;
+                fall_asleep = event_minute(event.key);
                 break;
-            }
             case EVENT_WAKEUP:
             {
-                wakeup = event->datetime.tm_min;
-                guard_stats_t *gs = &stats[current_id];
-                gs->total_minutes_asleep += (wakeup - fall_asleep);
-                if (gs->guard_id != most_sleepy_guard->guard_id) {
-                    if (gs->total_minutes_asleep > most_sleepy_guard->total_minutes_asleep) {
-                        most_sleepy_guard = gs;
-                    }
+                uint32_t wakeup = event_minute(event.key);
+                if (current == SIZE_MAX || wakeup < fall_asleep) {
+                    break;
                 }
+                guards->total_asleep[current] += (wakeup - fall_asleep);
+                uint16_t *row = guards->minutes[current];
                 for (uint32_t i = fall_asleep; i < wakeup; ++i) {
-                    gs->minutes[i] += 1;
-                    if (gs->minutes[i] > gs->minutes[gs->most_seen_minute]) {
-                        gs->most_seen_minute = i;
-                    }
-
-                    if (minutes[i].times_asleep == 0) {
-                        minutes[i].guard_id = gs->guard_id;
-                        minutes[i].times_asleep = 1;
-                    } else {
-                        if (gs->minutes[i] > minutes[i].times_asleep) {
-                            minutes[i].guard_id = gs->guard_id;
-                            minutes[i].times_asleep = gs->minutes[i];
-                        }
-                    }
-
-                    if (most_seen_minute == (uint32_t)-1) {
-                        most_seen_minute = i; 
-                        times_most_seen_minute = 1;
-                    } else {
-                        if (times_most_seen_minute < minutes[i].times_asleep) {
-                            most_seen_minute = i;
-                            times_most_seen_minute = minutes[i].times_asleep;
-                        }
-                    }
+                    row[i] += 1;
                 }
                 break;
             }
         }
     }
+    extsort_free(sorter);
+    DIE_IF((guards->count == 0), "No guards in %s", filename);
+
+    size_t sleepiest = 0;
+    for (size_t g = 1; g < guards->count; ++g) {
+        if (guards->total_asleep[g] > guards->total_asleep[sleepiest]) {
+            sleepiest = g;
+        }
+    }
+    uint32_t sleepiest_id = guards->ids[sleepiest];
+    uint32_t sleepiest_minute = guard_most_seen_minute(guards->minutes[sleepiest]);
+
+    // The per-minute maxima are kept across all 60 minutes at once, so each
+    // guard's row is a straight element-wise compare against them.
+    uint16_t best_count[MINUTES_PER_HOUR] = {0};
+    uint32_t best_guard[MINUTES_PER_HOUR] = {0};
+    for (size_t g = 0; g < guards->count; ++g) {
+        const uint16_t *row = guards->minutes[g];
+        for (uint32_t m = 0; m < MINUTES_PER_HOUR; ++m) {
+            bool better = row[m] > best_count[m];
+            best_count[m] = better ? row[m] : best_count[m];
+            best_guard[m] = better ? (uint32_t)g : best_guard[m];
+        }
+    }
+    uint32_t most_seen_minute = guard_most_seen_minute(best_count);
+    uint32_t most_seen_id = guards->ids[best_guard[most_seen_minute]];
 
-    printf("The most sleepy guard is %u with %u total minutes asleep, and is most often asleep at minute %u. Answer is %u\n", most_sleepy_guard->guard_id, most_sleepy_guard->total_minutes_asleep, most_sleepy_guard->most_seen_minute, (most_sleepy_guard->guard_id * most_sleepy_guard->most_seen_minute));
-    printf("Guard %u spent minute %u more than any other guard or minute. Answer is %u\n", minutes[most_seen_minute].guard_id, most_seen_minute,(minutes[most_seen_minute].guard_id * most_seen_minute));
-    free(stats);
-    file_free(file);
+    printf("The most sleepy guard is %u with %u total minutes asleep, and is most often asleep at minute %u. Answer is %u\n", sleepiest_id, guards->total_asleep[sleepiest], sleepiest_minute, (sleepiest_id * sleepiest_minute));
+    printf("Guard %u spent minute %u more than any other guard or minute. Answer is %u\n", most_seen_id, most_seen_minute, (most_seen_id * most_seen_minute));
+    guard_registry_free(guards);
 
     return 0;
 }
@@ -4,40 +4,44 @@
 #include <unistd.h>
 #include <string.h>
 #include <stdbool.h>
-#include <pthread.h>
 #include <bsd/stdlib.h>
 
 #include "file.h"
+#include "parse.h"
+#include "pool.h"
+#include "text.h"
 #include "utils.h"
 
 #define TRIGGER ((int)0x20)
 
 #define SHOULD_REACT(__a, __b) (abs(((int)__a) - ((int)__b)) == TRIGGER)
-#define DESTROY(__buf, __a, __b, __cnt) do { __buf[__a] = '\0'; __buf[__b] = '\0'; if (__a == 0) { __a += 2; __b += 2; } else { __a -= 1; __b += 1; } __cnt -= 2; } while (0)
+
+// Below this many units, splitting the reduction across threads costs more
+// than it saves.
+#define POLYMER_PARALLEL_MIN (1024 * 1024)
 
 typedef struct polymer {
     char *units;
-    size_t total_size;
-    size_t current_size;
-    size_t start;
-    size_t current;
-    size_t next;
+    size_t size;
 } polymer_t;
 
 polymer_t *polymer_create(char *buf, size_t size)
 {
+    // A trailing newline isn't part of the polymer.
+    while (size > 0 && parse_is_space(buf[size - 1])) {
+        size--;
+    }
+
     polymer_t *polymer = calloc(1, sizeof(polymer_t));
-    polymer->units = calloc(1, size);
-    memcpy(polymer->units, buf, size);
-    
-    if (polymer->units[size - 1] == '\n') {
-        polymer->units[size - 1] = '\0';
-        size -= 1;
+    VALIDATE_PTR_OR_RETURN(polymer, NULL);
+    polymer->units = malloc(size + 1);
+    if (polymer->units == NULL) {
+        free(polymer);
+        return NULL;
     }
-    polymer->current_size = polymer->total_size = size;
-    polymer->current = 0;
-    polymer->start = 0;
-    polymer->next = 1;
+    memcpy(polymer->units, buf, size);
+    polymer->units[size] = '\0';
+    polymer->size = size;
     return polymer;
 }
 
@@ -51,116 +55,119 @@ void polymer_free(polymer_t *polymer)
 
 void polymer_print(polymer_t *polymer)
 {
-    char buf[polymer->current_size + 1];
-    memset(buf, 0, polymer->current_size + 1);
-    for (size_t i = 0, j = 0; i < polymer->total_size; ++i) {
-        if (polymer->units[i] != '\0') {
-            buf[j++] = polymer->units[i];
-        }
-    }
-    printf("%s (C: %zu, N: %zu, Current: %zu, Total: %zu\n", buf, polymer->current, polymer->next, polymer->current_size, polymer->total_size);
+    printf("%.*s (Size: %zu)\n", (int)polymer->size, polymer->units, polymer->size);
 }
 
-static inline bool polymer_test(polymer_t *polymer)
+// Reacts units[0, size) down to nothing but inert units in one pass,
+// leaving the survivors in stack[0, return value). Units of type skip
+// (either polarity) are dropped as they're read; '\0' skips nothing.
+// stack[0, top) holds the units that have survived so far: each new unit
+// either annihilates with the top of the stack or is pushed onto it, so a
+// collapse of any length costs O(1) per unit and nothing is ever rescanned.
+// The stack never gets ahead of the input, so it may be units itself.
+//
+// A unit that goes on the stack takes the run of units after it along with
+// it, up to the next adjacent pair that could react or unit to skip. The
+// run is found a vector block at a time, so the inert stretches between
+// reactions are pushed in bulk rather than a unit at a time.
+static inline size_t polymer_react(const char *units, size_t size, char skip, char *stack)
 {
-    char a = polymer->units[polymer->current];
-    char b = polymer->units[polymer->next];
-    if (SHOULD_REACT(a, b)) {
-        return true;
-    } else {
-        return false;
+    size_t top = 0;
+    size_t i = 0;
+    while (i < size) {
+        char unit = units[i];
+        if (skip != '\0' && (unit & ~TRIGGER) == skip) {
+            i++;
+        } else if (top > 0 && SHOULD_REACT(stack[top - 1], unit)) {
+            top--;
+            i++;
+        } else {
+            size_t run = text_case_run(units + i, size - i, skip);
+            if (stack + top != units + i) {
+                memmove(stack + top, units + i, run);
+            }
+            top += run;
+            i += run;
+        }
     }
+    return top;
 }
 
-static inline bool polymer_done_processing(polymer_t *polymer)
+// Reduces the polymer in place and returns it.
+polymer_t *polymer_reduce(polymer_t *polymer)
 {
-    return (polymer->next == (polymer->total_size - 1));
+    polymer->size = polymer_react(polymer->units, polymer->size, '\0', polymer->units);
+    polymer->units[polymer->size] = '\0';
+    return polymer;
 }
 
-#define likely(x)       __builtin_expect((x),1)
-#define unlikely(x)     __builtin_expect((x),0)
+// What's left of a chunk of the polymer once it has reacted on its own:
+// units[begin, begin + size) of the polymer being reduced.
+typedef struct polymer_residue {
+    size_t begin;
+    size_t size;
+} polymer_residue_t;
 
-static inline void polymer_update(polymer_t *polymer)
+static void polymer_reduce_chunk(void *ctx, size_t begin, size_t end, void *result)
 {
-    char a = polymer->units[polymer->current];
-    char b = polymer->units[polymer->next];
-
-    // Case 1: We just destroyed a pair.
-    if (a == '\0' && b == '\0') {
-        // Special case: we destroy the first two units
-        if (unlikely(polymer->current == polymer->start)) {
-            // Skip over the destroyed units and set start to current
-            polymer->current += 2;
-            polymer->next += 2;
-            polymer->start = polymer->current;
-        } else {
-            while (polymer->units[polymer->current] == '\0') {
-                polymer->current -= 1;
-            }
-            polymer->next += 1;
-        }
+    polymer_t *polymer = ctx;
+    polymer_residue_t *residue = result;
+    residue->begin = begin;
+    residue->size = polymer_react(polymer->units + begin, end - begin, '\0', polymer->units + begin);
+}
 
-        // Update size
-        polymer->current_size -= 2;
-    } else {
-        // Case 2: We didn't destroy anything. Set current equal to next
-        // and next is incremented by one
-        polymer->current = polymer->next;
-        polymer->next += 1;
+// Reacts the tail of the left residue against the head of the right one,
+// then slides what's left of the right one down to join the left.
+static void polymer_merge_residues(void *ctx, void *left, const void *right)
+{
+    polymer_t *polymer = ctx;
+    polymer_residue_t *l = left;
+    polymer_residue_t r = *(const polymer_residue_t *)right;
+    while (l->size > 0 && r.size > 0 && SHOULD_REACT(polymer->units[l->begin + l->size - 1], polymer->units[r.begin])) {
+        l->size--;
+        r.begin++;
+        r.size--;
     }
+    memmove(polymer->units + l->begin + l->size, polymer->units + r.begin, r.size);
+    l->size += r.size;
 }
 
-static inline void polymer_remove(polymer_t *polymer, char c)
+// Reaction is associative, so each chunk of the polymer can be reduced on
+// its own and the residues merged afterwards. A chunk's residue only has
+// to react at its ends, which makes the merges cheap next to the chunks.
+polymer_t *polymer_reduce_parallel(polymer_t *polymer, pool_t *pool)
 {
-    for (size_t i = 0; i < polymer->total_size; ++i) {
-        if (polymer->units[i] == c || polymer->units[i] == (c + TRIGGER)) {
-            polymer->units[i] = '\0';
-            polymer->current_size -= 1;
-        }
+    if (polymer->size < POLYMER_PARALLEL_MIN) {
+        return polymer_reduce(polymer);
     }
-    char *newbuf = calloc(1, polymer->current_size + 1);
-    memset(newbuf, 0, polymer->current_size + 1);
-    for (size_t i = 0, j = 0; i < polymer->total_size; ++i) {
-        if (polymer->units[i] != '\0') {
-            newbuf[j++] = polymer->units[i];
-        }
-    }
-    polymer->total_size = polymer->current_size;
-    free(polymer->units);
-    polymer->units = newbuf;
-    //polymer_print(polymer);
-}
 
-struct args {
-    char c;
-    char *buf;
-    size_t size;
-};
+    polymer_residue_t residue = {0};
+    DIE_IF(!pool_reduce(pool, polymer->size, 0, polymer_reduce_chunk, polymer_merge_residues, polymer, &residue, sizeof(residue)),
+           "Could not reduce %zu units", polymer->size);
+    polymer->size = residue.size;
+    polymer->units[polymer->size] = '\0';
+    return polymer;
+}
 
-void polymer_destroy(polymer_t *polymer)
+// Size of the polymer with every unit of type c taken out, once reduced.
+// Taking units out of an already reduced polymer ends up in the same place
+// as taking them out of the original, so the reduced polymer is read as it
+// is and only the scratch stack is written.
+size_t polymer_reduced_size_without(const polymer_t *polymer, char c, char *scratch)
 {
-#if 0
-    char a = polymer->units[polymer->current];
-    char b = polymer->units[polymer->next];
-    printf("Destroyed %c%c\n", a, b);
-#endif
-    polymer->units[polymer->current] = '\0';
-    polymer->units[polymer->next] = '\0';
+    return polymer_react(polymer->units, polymer->size, c, scratch);
 }
 
-void *find_size_thread(void *args)
+struct variant {
+    char c;
+    const polymer_t *polymer;
+    char *scratch;
+};
+
+static void find_size_task(void *ctx, void *result)
 {
-    struct args *a = args;
-    polymer_t *p = polymer_create(a->buf, a->size);
-    polymer_remove(p, a->c);
-    while (!polymer_done_processing(p)) {
-        if (polymer_test(p)) {
-            polymer_destroy(p);
-        }
-        polymer_update(p);
-    }
-    
-    return (void *)p->current_size;
+    struct variant *v = ctx;
+    *(size_t *)result = polymer_reduced_size_without(v->polymer, v->c, v->scratch);
 }
 
 int main(int argc, char *argv[])
@@ -177,41 +184,40 @@ int main(int argc, char *argv[])
 
     polymer_length = file_size(file);
     char *buf = file_contents(file);
+    pool_t *pool = pool_create(0);
+    DIE_IF((pool == NULL), "Could not start a thread pool");
     polymer = polymer_create(buf, polymer_length);
+    DIE_IF((polymer == NULL), "Could not copy polymer");
+    polymer_reduce_parallel(polymer, pool);
 
-    while (!polymer_done_processing(polymer)) {
-        if (polymer_test(polymer)) {
-            polymer_destroy(polymer);
-        }
-        polymer_update(polymer);
-        //polymer_print(polymer);
-    }
-
-    printf("The answer is %zu\n", polymer->current_size);
-    size_t best_size = polymer->current_size;
-    polymer_free(polymer);
+    printf("The answer is %zu\n", polymer->size);
+    size_t best_size = polymer->size;
 
-#if 1
-    pthread_t threads[26];
-    struct args *args = calloc(26, sizeof(struct args));
+    // One scratch stack per variant, carved out of a single allocation.
+    struct variant variants[26];
+    pool_future_t *futures[26];
+    char *scratch = malloc(26 * (polymer->size + 1));
+    DIE_IF((scratch == NULL), "Could not allocate scratch for %zu units", polymer->size);
     for (char c = 'A'; c <= 'Z'; ++c) {
         int i = c - 'A';
-        args[i].c = c;
-        args[i].buf = buf;
-        args[i].size = polymer_length;
-        pthread_create(&threads[i], NULL, find_size_thread, &args[i]);
+        variants[i].c = c;
+        variants[i].polymer = polymer;
+        variants[i].scratch = scratch + (i * (polymer->size + 1));
+        futures[i] = pool_submit(pool, find_size_task, &variants[i], sizeof(size_t));
+        DIE_IF((futures[i] == NULL), "Could not submit variant %c", c);
     }
-    for (char c = 'A'; c <= 'Z'; ++c) {
-        int i = c - 'A';
-        size_t ret = 0;
-        pthread_join(threads[i], (void **)&ret);
-        if (ret < best_size) {
-            best_size = ret;
+    for (int i = 0; i < 26; ++i) {
+        size_t size = POOL_WAIT(pool, futures[i], size_t);
+        if (size < best_size) {
+            best_size = size;
         }
+        pool_future_free(futures[i]);
     }
 
     printf("The new best size is %zu\n", best_size);
-#endif
+    free(scratch);
+    pool_free(pool);
+    polymer_free(polymer);
     file_free(file);
 
     return 0;
@@ -0,0 +1,114 @@
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdbool.h>
+#include <bsd/stdlib.h>
+
+#include "file.h"
+#include "scan.h"
+#include "utils.h"
+
+// Compares the old getline()/file_next_line() loader against the mapped
+// loader and each newline scanning kernel on its own. Throughput is the
+// input size divided by wall time, averaged over all iterations.
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+static void report(const char *name, size_t bytes, size_t lines, double elapsed)
+{
+    printf("%-24s %10zu lines %8.3f ms %8.3f GB/s\n", name, lines, elapsed * 1e3, (bytes / elapsed) / 1e9);
+}
+
+static size_t bench_next_line(const char *filename)
+{
+    FILE *fp = fopen(filename, "r");
+    DIE_IF((fp == NULL), "Could not open %s", filename);
+    size_t nlines = 0;
+    line_t *line = NULL;
+    while ((line = file_next_line(fp)) != NULL) {
+        nlines++;
+        free(line->str);
+        free(line);
+    }
+    fclose(fp);
+    return nlines;
+}
+
+static size_t bench_get_lines(const char *filename)
+{
+    file_t *file = file_get_lines(filename, NULL, NULL);
+    DIE_IF((file == NULL), "Could not read lines from %s", filename);
+    size_t nlines = file_line_count(file);
+    file_free(file);
+    return nlines;
+}
+
+static size_t bench_kernel(scan_newlines_t kernel, const char *buf, size_t size)
+{
+    size_t positions[FILE_SCAN_BATCH];
+    size_t nlines = 0;
+    size_t offset = 0;
+    while (offset < size) {
+        size_t scanned = 0;
+        nlines += kernel(buf + offset, size - offset, positions, FILE_SCAN_BATCH, &scanned);
+        offset += scanned;
+    }
+    return nlines;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        printf("usage: %s [input] [iterations]\n", getprogname());
+        return EXIT_FAILURE;
+    }
+
+    const char *filename = argv[1];
+    int iterations = (argc > 2) ? atoi(argv[2]) : 10;
+    DIE_IF((iterations <= 0), "Bad iteration count %s", argv[2]);
+
+    file_t *file = file_open(filename);
+    DIE_IF((file == NULL), "Could not read input %s", filename);
+    size_t size = file_size(file);
+    size_t total = size * iterations;
+    size_t nlines = 0;
+    double start = 0;
+
+    start = now();
+    for (int i = 0; i < iterations; ++i) {
+        nlines = bench_next_line(filename);
+    }
+    report("file_next_line", total, nlines, now() - start);
+
+    start = now();
+    for (int i = 0; i < iterations; ++i) {
+        nlines = bench_get_lines(filename);
+    }
+    report("file_get_lines", total, nlines, now() - start);
+
+    struct {
+        const char *name;
+        scan_newlines_t kernel;
+    } kernels[] = {
+        { "scan_newlines_scalar", scan_newlines_scalar },
+        { "scan_newlines_sse2", scan_newlines_sse2 },
+        { "scan_newlines_avx2", scan_newlines_avx2 },
+    };
+    for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); ++k) {
+        start = now();
+        for (int i = 0; i < iterations; ++i) {
+            nlines = bench_kernel(kernels[k].kernel, file_contents(file), size);
+        }
+        report(kernels[k].name, total, nlines, now() - start);
+    }
+
+    file_free(file);
+    return 0;
+}
@@ -0,0 +1,162 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "utils.h"
+#include "arena.h"
+
+#define ARENA_ROUND(__size) (((__size) + (ARENA_ALIGNMENT - 1)) & ~((size_t)ARENA_ALIGNMENT - 1))
+
+arena_t *arena_create(size_t block_size)
+{
+    arena_t *arena = calloc(1, sizeof(arena_t));
+    VALIDATE_PTR_OR_RETURN(arena, NULL);
+    arena->block_size = block_size ? ARENA_ROUND(block_size) : ARENA_DEFAULT_BLOCK_SIZE;
+    return arena;
+}
+
+// A dedicated block is linked in behind the head, so the head stays the
+// block that small allocations are bumped from.
+static arena_block_t *arena_new_block(arena_t *arena, size_t size, bool dedicated)
+{
+    arena_block_t *block = malloc(sizeof(arena_block_t) + size);
+    VALIDATE_PTR_OR_RETURN(block, NULL);
+    block->size = size;
+    block->used = 0;
+    if (dedicated && arena->head) {
+        block->next = arena->head->next;
+        arena->head->next = block;
+    } else {
+        block->next = arena->head;
+        arena->head = block;
+    }
+    arena->total += size;
+    return block;
+}
+
+// The link to the block ptr fills on its own, if that block is the head or
+// sits right behind it (where a dedicated block goes).
+static arena_block_t **arena_sole_link(arena_t *arena, void *ptr, size_t size)
+{
+    arena_block_t **link = &arena->head;
+    for (int i = 0; i < 2 && *link; ++i, link = &(*link)->next) {
+        if ((*link)->data == (char *)ptr && (*link)->used == size) {
+            return link;
+        }
+    }
+    return NULL;
+}
+
+void *arena_alloc(arena_t *arena, size_t size)
+{
+    size = ARENA_ROUND(size);
+    arena_block_t *block = arena->head;
+    if (block == NULL || (block->size - block->used) < size) {
+        // Anything bigger than a quarter block gets a block of its own, so
+        // one large request doesn't strand the rest of a normal block.
+        bool dedicated = (size > (arena->block_size / 4));
+        block = arena_new_block(arena, dedicated ? size : arena->block_size, dedicated);
+        VALIDATE_PTR_OR_RETURN(block, NULL);
+    }
+
+    void *ptr = block->data + block->used;
+    block->used += size;
+    return ptr;
+}
+
+void *arena_calloc(arena_t *arena, size_t count, size_t size)
+{
+    void *ptr = arena_alloc(arena, count * size);
+    if (ptr) {
+        memset(ptr, 0, count * size);
+    }
+    return ptr;
+}
+
+void *arena_realloc(arena_t *arena, void *ptr, size_t old_size, size_t new_size)
+{
+    if (ptr == NULL) {
+        return arena_alloc(arena, new_size);
+    }
+
+    // The most recent allocation in the current block can grow where it is.
+    arena_block_t *block = arena->head;
+    if (block && ((char *)ptr >= block->data) && ((char *)ptr + ARENA_ROUND(old_size)) == (block->data + block->used)) {
+        size_t offset = (char *)ptr - block->data;
+        if ((offset + ARENA_ROUND(new_size)) <= block->size) {
+            block->used = offset + ARENA_ROUND(new_size);
+            return ptr;
+        }
+    }
+
+    // If it's the only thing in its block the whole block is resized, which
+    // lets one large table double its way up without leaving old copies
+    // behind.
+    arena_block_t **link = arena_sole_link(arena, ptr, ARENA_ROUND(old_size));
+    if (link) {
+        size_t size = ARENA_ROUND(new_size);
+        arena_block_t *grown = realloc(*link, sizeof(arena_block_t) + size);
+        VALIDATE_PTR_OR_RETURN(grown, NULL);
+        arena->total += size - grown->size;
+        grown->size = size;
+        grown->used = size;
+        *link = grown;
+        return grown->data;
+    }
+
+    void *new_ptr = arena_alloc(arena, new_size);
+    if (new_ptr) {
+        memcpy(new_ptr, ptr, (old_size < new_size) ? old_size : new_size);
+    }
+    return new_ptr;
+}
+
+char *arena_strndup(arena_t *arena, const char *str, size_t len)
+{
+    char *copy = arena_alloc(arena, len + 1);
+    if (copy) {
+        memcpy(copy, str, len);
+        copy[len] = '\0';
+    }
+    return copy;
+}
+
+// Moves all of src's blocks into dst and frees src. Allocations made from src
+// stay valid and are now released with dst.
+void arena_adopt(arena_t *dst, arena_t *src)
+{
+    if (src == NULL) {
+        return;
+    }
+
+    if (src->head) {
+        arena_block_t *tail = src->head;
+        while (tail->next) {
+            tail = tail->next;
+        }
+
+        // Splice behind dst's head so dst keeps bumping from the same block.
+        if (dst->head) {
+            tail->next = dst->head->next;
+            dst->head->next = src->head;
+        } else {
+            dst->head = src->head;
+        }
+        dst->total += src->total;
+    }
+    free(src);
+}
+
+void arena_free(arena_t *arena)
+{
+    if (arena) {
+        arena_block_t *block = arena->head;
+        while (block) {
+            arena_block_t *next = block->next;
+            free(block);
+            block = next;
+        }
+        free(arena);
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// Every allocation is rounded up to this so any type can be carved out.
+#define ARENA_ALIGNMENT (16)
+#define ARENA_DEFAULT_BLOCK_SIZE (64 * 1024)
+
+typedef struct arena_block
+{
+    struct arena_block *next;
+    size_t size;
+    size_t used;
+    _Alignas(ARENA_ALIGNMENT) char data[];
+} arena_block_t;
+
+// A bump allocator: memory is handed out from large blocks and can only be
+// released all at once with arena_free().
+typedef struct arena
+{
+    arena_block_t *head;
+    size_t block_size;
+    size_t total;
+} arena_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+static inline size_t arena_total_size(arena_t *arena)
+{
+    return arena->total;
+}
+
+arena_t *arena_create(size_t block_size);
+void *arena_alloc(arena_t *arena, size_t size);
+void *arena_calloc(arena_t *arena, size_t count, size_t size);
+void *arena_realloc(arena_t *arena, void *ptr, size_t old_size, size_t new_size);
+char *arena_strndup(arena_t *arena, const char *str, size_t len);
+void arena_adopt(arena_t *dst, arena_t *src);
+void arena_free(arena_t *arena);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
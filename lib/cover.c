@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils.h"
+#include "cover.h"
+
+cover_t *cover_create(uint32_t width, uint32_t height)
+{
+    cover_t *cover = calloc(1, sizeof(cover_t));
+    VALIDATE_PTR_OR_RETURN(cover, NULL);
+    cover->width = width;
+    cover->height = height;
+
+    // One spare row and column so the far corners of a rectangle on the
+    // edge still have somewhere to go.
+    cover->cells = grid_create(width + 1, height + 1, GRID_CELL_32);
+    if (cover->cells == NULL) {
+        free(cover);
+        return NULL;
+    }
+    return cover;
+}
+
+// Must be called before cover_resolve(). The rectangle has to lie inside
+// the area the cover was created with.
+void cover_add(cover_t *cover, uint32_t x, uint32_t y, uint32_t width, uint32_t height)
+{
+    if (width == 0 || height == 0) {
+        return;
+    }
+
+    grid_t *cells = cover->cells;
+    GRID_AT(cells, uint32_t, x, y) += 1;
+    GRID_AT(cells, uint32_t, x + width, y) -= 1;
+    GRID_AT(cells, uint32_t, x, y + height) -= 1;
+    GRID_AT(cells, uint32_t, x + width, y + height) += 1;
+}
+
+// Runs down the rows once. The coverage of the row above is kept on the
+// side, so each cell's difference can be replaced in place by the
+// summed-area value of the overlap indicator: the number of cells covered
+// twice or more in [0, x] x [0, y].
+void cover_resolve(cover_t *cover)
+{
+    if (cover->resolved) {
+        return;
+    }
+
+    grid_t *cells = cover->cells;
+    uint32_t *coverage = calloc(cover->width, sizeof(uint32_t));
+    DIE_IF((coverage == NULL), "Could not allocate a row of %u cells", cover->width);
+
+    uint64_t overlap = 0;
+    const uint32_t *sums_above = NULL;
+    for (uint32_t y = 0; y < cover->height; ++y) {
+        uint32_t *row = GRID_ROW(cells, uint32_t, y);
+        uint32_t difference = 0;
+        uint32_t overlap_in_row = 0;
+        for (uint32_t x = 0; x < cover->width; ++x) {
+            difference += row[x];
+            coverage[x] += difference;
+            overlap_in_row += (coverage[x] >= 2);
+            row[x] = overlap_in_row + (sums_above ? sums_above[x] : 0);
+        }
+        overlap += overlap_in_row;
+        sums_above = row;
+    }
+
+    free(coverage);
+    cover->overlap = overlap;
+    cover->resolved = true;
+}
+
+static inline uint32_t cover_sum_to(cover_t *cover, uint32_t x_end, uint32_t y_end)
+{
+    if (x_end == 0 || y_end == 0) {
+        return 0;
+    }
+    return GRID_AT(cover->cells, uint32_t, x_end - 1, y_end - 1);
+}
+
+// Whether any cell of the rectangle is covered more than once, in O(1).
+// Only valid after cover_resolve().
+bool cover_overlaps(cover_t *cover, uint32_t x, uint32_t y, uint32_t width, uint32_t height)
+{
+    uint32_t x_end = x + width;
+    uint32_t y_end = y + height;
+    uint32_t sum = cover_sum_to(cover, x_end, y_end) - cover_sum_to(cover, x, y_end)
+        - cover_sum_to(cover, x_end, y) + cover_sum_to(cover, x, y);
+    return sum != 0;
+}
+
+void cover_free(cover_t *cover)
+{
+    if (cover) {
+        grid_free(cover->cells);
+        free(cover);
+    }
+}
@@ -0,0 +1,46 @@
+#ifndef COVER_H
+#define COVER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "grid.h"
+
+// Counts how many rectangles cover each cell of a width x height area
+// without touching every cell of every rectangle. Each rectangle is four
+// corner updates in a difference array; cover_resolve() then turns the
+// differences into coverage in one prefix-sum pass and keeps a summed-area
+// table of the cells covered at least twice.
+//
+// Cells are 32 bits and sums wrap, which is still exact for any rectangle
+// of fewer than 2^32 cells.
+typedef struct cover
+{
+    uint32_t width;
+    uint32_t height;
+    grid_t *cells;
+    uint64_t overlap;
+    bool resolved;
+} cover_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+static inline uint64_t cover_overlap_area(cover_t *cover)
+{
+    return cover->overlap;
+}
+
+cover_t *cover_create(uint32_t width, uint32_t height);
+void cover_add(cover_t *cover, uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+void cover_resolve(cover_t *cover);
+bool cover_overlaps(cover_t *cover, uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+void cover_free(cover_t *cover);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
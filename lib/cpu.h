@@ -0,0 +1,43 @@
+#ifndef CPU_H
+#define CPU_H
+
+#include <stdbool.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CPU_X86 1
+#include <immintrin.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Runtime feature checks used to pick a kernel the first time it is called.
+// Kernels are compiled with __attribute__((target(...))) so the Day
+// Makefiles don't need any -m flags.
+
+static inline bool cpu_has_sse2(void)
+{
+#ifdef CPU_X86
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+#else
+    return false;
+#endif
+}
+
+static inline bool cpu_has_avx2(void)
+{
+#ifdef CPU_X86
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,310 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils.h"
+#include "extsort.h"
+
+#define EXTSORT_RECORD(__base, __i, __size) ((char *)(__base) + ((__i) * (__size)))
+
+// The radix sort needs a (key, index) pair twice over plus a copy of the
+// records on top of the run itself.
+#define EXTSORT_SORT_OVERHEAD (2 * (sizeof(uint64_t) + sizeof(size_t)))
+
+extsort_t *extsort_create(size_t record_size, size_t memory, sort_key_t key, void *ctx)
+{
+    if (record_size == 0 || key == NULL) {
+        ERR("Bad record size %zu or missing key", record_size);
+        return NULL;
+    }
+
+    extsort_t *sorter = calloc(1, sizeof(extsort_t));
+    VALIDATE_PTR_OR_RETURN(sorter, NULL);
+    sorter->record_size = record_size;
+    sorter->key = key;
+    sorter->ctx = ctx;
+    sorter->run_records = memory / ((2 * record_size) + EXTSORT_SORT_OVERHEAD);
+    if (sorter->run_records == 0) {
+        sorter->run_records = 1;
+    }
+
+    sorter->buffer = malloc(sorter->run_records * record_size);
+    if (sorter->buffer == NULL) {
+        ERR("Could not allocate a run of %zu records", sorter->run_records);
+        free(sorter);
+        return NULL;
+    }
+    return sorter;
+}
+
+static FILE *extsort_new_run(void)
+{
+    FILE *fp = tmpfile();
+    if (fp == NULL) {
+        ERR("Could not create a temporary run file");
+        return NULL;
+    }
+    setvbuf(fp, NULL, _IOFBF, EXTSORT_IO_BUFFER);
+    return fp;
+}
+
+static bool extsort_push_run(extsort_t *sorter, FILE *run)
+{
+    if (sorter->nruns == sorter->runs_capacity) {
+        size_t capacity = sorter->runs_capacity ? (2 * sorter->runs_capacity) : EXTSORT_MAX_FANIN;
+        FILE **runs = realloc(sorter->runs, capacity * sizeof(FILE *));
+        VALIDATE_PTR_OR_RETURN(runs, false);
+        sorter->runs = runs;
+        sorter->runs_capacity = capacity;
+    }
+    sorter->runs[sorter->nruns++] = run;
+    return true;
+}
+
+// Sorts the run buffer and writes it out as a new run.
+static bool extsort_spill(extsort_t *sorter)
+{
+    sort_radix(sorter->buffer, sorter->count, sorter->record_size, sorter->key, sorter->ctx);
+    FILE *run = extsort_new_run();
+    if (run == NULL) {
+        return false;
+    }
+
+    if (fwrite(sorter->buffer, sorter->record_size, sorter->count, run) != sorter->count || !extsort_push_run(sorter, run)) {
+        ERR("Could not write a run of %zu records", sorter->count);
+        fclose(run);
+        return false;
+    }
+    sorter->count = 0;
+    return true;
+}
+
+bool extsort_add(extsort_t *sorter, const void *record)
+{
+    if (sorter->finished) {
+        ERR("Records can't be added once the sort is finished");
+        return false;
+    }
+
+    if (sorter->count == sorter->run_records && !extsort_spill(sorter)) {
+        return false;
+    }
+    memcpy(EXTSORT_RECORD(sorter->buffer, sorter->count, sorter->record_size), record, sorter->record_size);
+    sorter->count++;
+    return true;
+}
+
+// Heap order: smaller key first, then earlier run, which keeps the merge
+// stable.
+static bool extsort_merge_less(extsort_merge_t *merge, size_t a, size_t b)
+{
+    if (merge->keys[a] != merge->keys[b]) {
+        return merge->keys[a] < merge->keys[b];
+    }
+    return a < b;
+}
+
+static void extsort_merge_sift_down(extsort_merge_t *merge, size_t i)
+{
+    for (;;) {
+        size_t smallest = i;
+        size_t left = (2 * i) + 1;
+        size_t right = left + 1;
+        if (left < merge->heap_size && extsort_merge_less(merge, merge->heap[left], merge->heap[smallest])) {
+            smallest = left;
+        }
+        if (right < merge->heap_size && extsort_merge_less(merge, merge->heap[right], merge->heap[smallest])) {
+            smallest = right;
+        }
+        if (smallest == i) {
+            return;
+        }
+
+        size_t swap = merge->heap[i];
+        merge->heap[i] = merge->heap[smallest];
+        merge->heap[smallest] = swap;
+        i = smallest;
+    }
+}
+
+// Loads the next record of run r, returning false once it's used up.
+static bool extsort_merge_load(extsort_t *sorter, extsort_merge_t *merge, size_t r)
+{
+    char *record = EXTSORT_RECORD(merge->records, r, sorter->record_size);
+    if (fread(record, sorter->record_size, 1, merge->runs[r]) != 1) {
+        return false;
+    }
+    merge->keys[r] = sorter->key(record, sorter->ctx);
+    return true;
+}
+
+static bool extsort_merge_open(extsort_t *sorter, extsort_merge_t *merge, FILE **runs, size_t nruns)
+{
+    merge->runs = runs;
+    merge->nruns = nruns;
+    merge->records = malloc(nruns * sorter->record_size);
+    merge->keys = malloc(nruns * sizeof(uint64_t));
+    merge->heap = malloc(nruns * sizeof(size_t));
+    merge->heap_size = 0;
+    if (merge->records == NULL || merge->keys == NULL || merge->heap == NULL) {
+        ERR("Could not allocate a merge of %zu runs", nruns);
+        free(merge->heap);
+        free(merge->records);
+        free(merge->keys);
+        memset(merge, 0, sizeof(*merge));
+        return false;
+    }
+
+    for (size_t r = 0; r < nruns; ++r) {
+        rewind(runs[r]);
+        if (extsort_merge_load(sorter, merge, r)) {
+            merge->heap[merge->heap_size++] = r;
+        }
+    }
+    for (size_t i = merge->heap_size; i-- > 0; ) {
+        extsort_merge_sift_down(merge, i);
+    }
+    return true;
+}
+
+static bool extsort_merge_next(extsort_t *sorter, extsort_merge_t *merge, void *record)
+{
+    if (merge->heap_size == 0) {
+        return false;
+    }
+
+    size_t r = merge->heap[0];
+    memcpy(record, EXTSORT_RECORD(merge->records, r, sorter->record_size), sorter->record_size);
+    if (!extsort_merge_load(sorter, merge, r)) {
+        merge->heap[0] = merge->heap[--merge->heap_size];
+    }
+    extsort_merge_sift_down(merge, 0);
+    return true;
+}
+
+static void extsort_merge_close(extsort_merge_t *merge)
+{
+    for (size_t r = 0; r < merge->nruns; ++r) {
+        fclose(merge->runs[r]);
+    }
+    free(merge->heap);
+    free(merge->records);
+    free(merge->keys);
+    memset(merge, 0, sizeof(*merge));
+}
+
+// After a failed merge pass, keeps the run list to the runs that are still
+// open (the nmerged merged so far and those from first on) so
+// extsort_free() closes each of them exactly once.
+static void extsort_keep_runs(extsort_t *sorter, size_t nmerged, size_t first)
+{
+    memmove(&sorter->runs[nmerged], &sorter->runs[first], (sorter->nruns - first) * sizeof(FILE *));
+    sorter->nruns = nmerged + (sorter->nruns - first);
+}
+
+// Merges groups of EXTSORT_MAX_FANIN neighbouring runs into one run each,
+// keeping the groups in order so ties still come out in insertion order.
+static bool extsort_merge_pass(extsort_t *sorter)
+{
+    size_t nmerged = 0;
+    char *record = malloc(sorter->record_size);
+    VALIDATE_PTR_OR_RETURN(record, false);
+
+    for (size_t first = 0; first < sorter->nruns; first += EXTSORT_MAX_FANIN) {
+        size_t count = sorter->nruns - first;
+        if (count > EXTSORT_MAX_FANIN) {
+            count = EXTSORT_MAX_FANIN;
+        }
+
+        FILE *out = extsort_new_run();
+        extsort_merge_t merge = {0};
+        if (out == NULL || !extsort_merge_open(sorter, &merge, &sorter->runs[first], count)) {
+            if (out) {
+                fclose(out);
+            }
+            extsort_keep_runs(sorter, nmerged, first);
+            free(record);
+            return false;
+        }
+
+        while (extsort_merge_next(sorter, &merge, record)) {
+            if (fwrite(record, sorter->record_size, 1, out) != 1) {
+                ERR("Could not write a merged run");
+                extsort_merge_close(&merge);
+                fclose(out);
+                extsort_keep_runs(sorter, nmerged, first + count);
+                free(record);
+                return false;
+            }
+        }
+        extsort_merge_close(&merge);
+        sorter->runs[nmerged++] = out;
+    }
+
+    free(record);
+    sorter->nruns = nmerged;
+    return true;
+}
+
+// No more records can be added after this; extsort_next() then hands them
+// back in order.
+bool extsort_finish(extsort_t *sorter)
+{
+    if (sorter->finished) {
+        return true;
+    }
+    sorter->finished = true;
+
+    if (sorter->nruns == 0) {
+        sort_radix(sorter->buffer, sorter->count, sorter->record_size, sorter->key, sorter->ctx);
+        sorter->position = 0;
+        return true;
+    }
+
+    if (sorter->count != 0 && !extsort_spill(sorter)) {
+        return false;
+    }
+    free(sorter->buffer);
+    sorter->buffer = NULL;
+
+    while (sorter->nruns > EXTSORT_MAX_FANIN) {
+        if (!extsort_merge_pass(sorter)) {
+            return false;
+        }
+    }
+    return extsort_merge_open(sorter, &sorter->merge, sorter->runs, sorter->nruns);
+}
+
+bool extsort_next(extsort_t *sorter, void *record)
+{
+    if (!sorter->finished) {
+        ERR("extsort_finish() has to be called before reading records back");
+        return false;
+    }
+
+    if (sorter->nruns == 0) {
+        if (sorter->position == sorter->count) {
+            return false;
+        }
+        memcpy(record, EXTSORT_RECORD(sorter->buffer, sorter->position, sorter->record_size), sorter->record_size);
+        sorter->position++;
+        return true;
+    }
+    return extsort_merge_next(sorter, &sorter->merge, record);
+}
+
+void extsort_free(extsort_t *sorter)
+{
+    if (sorter) {
+        if (sorter->merge.runs != NULL) {
+            extsort_merge_close(&sorter->merge);
+        } else {
+            for (size_t r = 0; r < sorter->nruns; ++r) {
+                fclose(sorter->runs[r]);
+            }
+        }
+        free(sorter->runs);
+        free(sorter->buffer);
+        free(sorter);
+    }
+}
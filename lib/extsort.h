@@ -0,0 +1,69 @@
+#ifndef EXTSORT_H
+#define EXTSORT_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "sort.h"
+
+// At most this many runs are merged at once; more than that are merged
+// down in passes first so open files and read buffers stay bounded.
+#define EXTSORT_MAX_FANIN (64)
+#define EXTSORT_IO_BUFFER (64 * 1024)
+#define EXTSORT_DEFAULT_MEMORY (256 * 1024 * 1024)
+
+// Reads the records of several sorted runs in key order through a binary
+// heap of the runs' current records. Ties go to the earlier run.
+typedef struct extsort_merge
+{
+    FILE **runs;
+    size_t nruns;
+    char *records;
+    uint64_t *keys;
+    size_t *heap;
+    size_t heap_size;
+} extsort_merge_t;
+
+// Sorts fixed-size records that might not fit in memory. Records are
+// gathered into a run buffer; each full buffer is radix sorted and spilled
+// to a temporary file, and reading them back is a k-way merge of those
+// files. If everything fits in one run nothing is spilled. The order is
+// stable.
+typedef struct extsort
+{
+    size_t record_size;
+    sort_key_t key;
+    void *ctx;
+    char *buffer;
+    size_t run_records;
+    size_t count;
+    FILE **runs;
+    size_t nruns;
+    size_t runs_capacity;
+    bool finished;
+    size_t position;
+    extsort_merge_t merge;
+} extsort_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+static inline size_t extsort_run_count(extsort_t *sorter)
+{
+    return sorter->nruns;
+}
+
+extsort_t *extsort_create(size_t record_size, size_t memory, sort_key_t key, void *ctx);
+bool extsort_add(extsort_t *sorter, const void *record);
+bool extsort_finish(extsort_t *sorter);
+bool extsort_next(extsort_t *sorter, void *record);
+void extsort_free(extsort_t *sorter);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,10 +1,13 @@
 #ifndef FILE_H
 #define FILE_H
 
+#include <stdio.h>
 #include <stdint.h>
 #include <unistd.h>
 #include <stdbool.h>
 
+#include "arena.h"
+
 typedef struct line
 {
     char *str;
@@ -12,9 +15,12 @@ typedef struct line
     void *extra;
 } line_t;
 
-typedef bool (*line_transform_t)(line_t *line);
+// Per-line payloads should be carved from the arena, which the file owns and
+// releases in one go with the rest of its lines.
+// Callbacks may run on several threads at once (see file_set_threads()), so
+// they should only touch the line they're given and the arena.
+typedef bool (*line_transform_t)(line_t *line, arena_t *arena);
 typedef void (*line_data_free_t)(line_t *line);
-typedef int (*line_sort_t)(const void *a, const void *b);
 
 typedef struct file
 {
@@ -23,13 +29,29 @@ typedef struct file
     size_t nlines;
     size_t capacity;
     line_t **lines;
-    line_sort_t sort_callback;
+    void *map;
+    size_t map_size;
+    arena_t *arena;
     line_data_free_t free_callback;
 } file_t;
 
 
+typedef void (*file_line_visit_t)(file_t *file, size_t offset, size_t len, void *ctx);
+
 #define FILE_LINES_INITIAL_CAPACITY (1000)
 
+// Zero bytes guaranteed to follow the contents of a mapped file, so the last
+// line is always NUL-terminated and scanners may read a little past the end.
+#define FILE_MAP_PADDING (64)
+
+// Newline positions collected per call into the scanner while indexing lines
+#define FILE_SCAN_BATCH (4096)
+
+#define FILE_ARENA_BLOCK_SIZE (1024 * 1024)
+
+// Inputs are only split across threads in slices of at least this much.
+#define FILE_PARALLEL_MIN_BYTES (1024 * 1024)
+
 #define file_for_each_line(__f, __l, __i) \
     for (__i = 0, __l = (line_t *)(((file_t *)__f)->lines[__i]); __i < file_line_count(__f); ++(__i), __l = (line_t *)(((file_t *)__f)->lines[__i])) \
 
@@ -72,10 +94,12 @@ static inline char *file_contents(file_t *file)
     return file->contents;
 }
 
-void file_sort_lines(file_t *lines);
-file_t *file_get_lines(const char *filename, line_transform_t transform_callback, line_data_free_t free_callback, line_sort_t sort_callback);
+file_t *file_get_lines(const char *filename, line_transform_t transform_callback, line_data_free_t free_callback);
 line_t *file_get_line(file_t *file, uint32_t lineno);
+line_t *file_next_line(FILE *fp);
+void file_set_threads(size_t threads);
 long *file_get_as_numbers(file_t *lines);
+int64_t *file_get_numbers(const char *filename, size_t *count);
 void file_free(file_t *file);
 file_t *file_open(const char *filename);
 
@@ -0,0 +1,503 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils.h"
+#include "cpu.h"
+#include "grid.h"
+
+#define GRID_LOW_BITS (0x5555555555555555ULL)
+
+// Low bit of every 2-bit cell of word that equals the matching cell of
+// pattern
+static inline uint64_t grid_match2(uint64_t word, uint64_t pattern)
+{
+    uint64_t diff = word ^ pattern;
+    return ~(diff | (diff >> 1)) & GRID_LOW_BITS;
+}
+
+static inline uint64_t grid_load64(const uint8_t *p)
+{
+    uint64_t word;
+    memcpy(&word, p, sizeof(word));
+    return word;
+}
+
+static uint64_t grid_count2_scalar(const void *cells, size_t n, uint32_t value)
+{
+    const uint8_t *bytes = cells;
+    uint64_t pattern = (value & 0x3) * GRID_LOW_BITS;
+    uint64_t count = 0;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        count += __builtin_popcountll(grid_match2(grid_load64(bytes + i), pattern));
+    }
+    for (; i < n; ++i) {
+        count += __builtin_popcountll(grid_match2(bytes[i], pattern) & 0x55);
+    }
+    return count;
+}
+
+static bool grid_any2_scalar(const void *cells, size_t n, uint32_t value)
+{
+    const uint8_t *bytes = cells;
+    uint64_t pattern = (value & 0x3) * GRID_LOW_BITS;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        if (grid_match2(grid_load64(bytes + i), pattern)) {
+            return true;
+        }
+    }
+    for (; i < n; ++i) {
+        if (grid_match2(bytes[i], pattern) & 0x55) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static uint64_t grid_count8_scalar(const void *cells, size_t n, uint32_t value)
+{
+    const uint8_t *bytes = cells;
+    uint64_t count = 0;
+    for (size_t i = 0; i < n; ++i) {
+        count += (bytes[i] == (uint8_t)value);
+    }
+    return count;
+}
+
+static bool grid_any8_scalar(const void *cells, size_t n, uint32_t value)
+{
+    return memchr(cells, (uint8_t)value, n) != NULL;
+}
+
+static uint64_t grid_count32_scalar(const void *cells, size_t n, uint32_t value)
+{
+    const uint32_t *words = cells;
+    uint64_t count = 0;
+    for (size_t i = 0; i < n; ++i) {
+        count += (words[i] == value);
+    }
+    return count;
+}
+
+static bool grid_any32_scalar(const void *cells, size_t n, uint32_t value)
+{
+    const uint32_t *words = cells;
+    for (size_t i = 0; i < n; ++i) {
+        if (words[i] == value) {
+            return true;
+        }
+    }
+    return false;
+}
+
+const grid_kernels_t grid_kernels_scalar = {
+    .count2 = grid_count2_scalar,
+    .count8 = grid_count8_scalar,
+    .count32 = grid_count32_scalar,
+    .any2 = grid_any2_scalar,
+    .any8 = grid_any8_scalar,
+    .any32 = grid_any32_scalar,
+};
+
+#ifdef CPU_X86
+
+// Per-byte count of matching 2-bit cells (0 to 4), as in grid_match2().
+// The 16-bit shifts leak bits across byte boundaries, but only into bit
+// positions the masks then clear.
+__attribute__((target("sse2")))
+static inline __m128i grid_match2_sse2(__m128i v, __m128i pattern)
+{
+    const __m128i low = _mm_set1_epi8(0x55);
+    const __m128i pairs = _mm_set1_epi8(0x33);
+    const __m128i nibbles = _mm_set1_epi8(0x0F);
+    __m128i diff = _mm_xor_si128(v, pattern);
+    __m128i match = _mm_andnot_si128(_mm_or_si128(diff, _mm_srli_epi16(diff, 1)), low);
+    __m128i sum = _mm_add_epi8(_mm_and_si128(match, pairs), _mm_and_si128(_mm_srli_epi16(match, 2), pairs));
+    return _mm_add_epi8(_mm_and_si128(sum, nibbles), _mm_and_si128(_mm_srli_epi16(sum, 4), nibbles));
+}
+
+__attribute__((target("sse2")))
+static uint64_t grid_count2_sse2(const void *cells, size_t n, uint32_t value)
+{
+    const uint8_t *bytes = cells;
+    const __m128i pattern = _mm_set1_epi8((char)((value & 0x3) * 0x55));
+    __m128i total = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(bytes + i));
+        total = _mm_add_epi64(total, _mm_sad_epu8(grid_match2_sse2(v, pattern), _mm_setzero_si128()));
+    }
+
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i *)lanes, total);
+    uint64_t count = lanes[0] + lanes[1];
+    return count + grid_count2_scalar(bytes + i, n - i, value);
+}
+
+__attribute__((target("sse2")))
+static bool grid_any2_sse2(const void *cells, size_t n, uint32_t value)
+{
+    const uint8_t *bytes = cells;
+    const __m128i pattern = _mm_set1_epi8((char)((value & 0x3) * 0x55));
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(bytes + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(grid_match2_sse2(v, pattern), zero)) != 0xFFFF) {
+            return true;
+        }
+    }
+    return grid_any2_scalar(bytes + i, n - i, value);
+}
+
+__attribute__((target("sse2")))
+static uint64_t grid_count8_sse2(const void *cells, size_t n, uint32_t value)
+{
+    const uint8_t *bytes = cells;
+    const __m128i wanted = _mm_set1_epi8((char)value);
+    uint64_t count = 0;
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(bytes + i));
+        count += __builtin_popcount((uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, wanted)));
+    }
+    return count + grid_count8_scalar(bytes + i, n - i, value);
+}
+
+__attribute__((target("sse2")))
+static bool grid_any8_sse2(const void *cells, size_t n, uint32_t value)
+{
+    const uint8_t *bytes = cells;
+    const __m128i wanted = _mm_set1_epi8((char)value);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(bytes + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(v, wanted))) {
+            return true;
+        }
+    }
+    return grid_any8_scalar(bytes + i, n - i, value);
+}
+
+__attribute__((target("sse2")))
+static uint64_t grid_count32_sse2(const void *cells, size_t n, uint32_t value)
+{
+    const uint32_t *words = cells;
+    const __m128i wanted = _mm_set1_epi32((int)value);
+    uint64_t count = 0;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(words + i));
+        count += __builtin_popcount((uint32_t)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(v, wanted))));
+    }
+    return count + grid_count32_scalar(words + i, n - i, value);
+}
+
+__attribute__((target("sse2")))
+static bool grid_any32_sse2(const void *cells, size_t n, uint32_t value)
+{
+    const uint32_t *words = cells;
+    const __m128i wanted = _mm_set1_epi32((int)value);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(words + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(v, wanted))) {
+            return true;
+        }
+    }
+    return grid_any32_scalar(words + i, n - i, value);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i grid_match2_avx2(__m256i v, __m256i pattern)
+{
+    const __m256i low = _mm256_set1_epi8(0x55);
+    const __m256i pairs = _mm256_set1_epi8(0x33);
+    const __m256i nibbles = _mm256_set1_epi8(0x0F);
+    __m256i diff = _mm256_xor_si256(v, pattern);
+    __m256i match = _mm256_andnot_si256(_mm256_or_si256(diff, _mm256_srli_epi16(diff, 1)), low);
+    __m256i sum = _mm256_add_epi8(_mm256_and_si256(match, pairs), _mm256_and_si256(_mm256_srli_epi16(match, 2), pairs));
+    return _mm256_add_epi8(_mm256_and_si256(sum, nibbles), _mm256_and_si256(_mm256_srli_epi16(sum, 4), nibbles));
+}
+
+__attribute__((target("avx2")))
+static uint64_t grid_count2_avx2(const void *cells, size_t n, uint32_t value)
+{
+    const uint8_t *bytes = cells;
+    const __m256i pattern = _mm256_set1_epi8((char)((value & 0x3) * 0x55));
+    __m256i total = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(bytes + i));
+        total = _mm256_add_epi64(total, _mm256_sad_epu8(grid_match2_avx2(v, pattern), _mm256_setzero_si256()));
+    }
+
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i *)lanes, total);
+    uint64_t count = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    return count + grid_count2_scalar(bytes + i, n - i, value);
+}
+
+__attribute__((target("avx2")))
+static bool grid_any2_avx2(const void *cells, size_t n, uint32_t value)
+{
+    const uint8_t *bytes = cells;
+    const __m256i pattern = _mm256_set1_epi8((char)((value & 0x3) * 0x55));
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(bytes + i));
+        __m256i match = grid_match2_avx2(v, pattern);
+        if (!_mm256_testz_si256(match, match)) {
+            return true;
+        }
+    }
+    return grid_any2_scalar(bytes + i, n - i, value);
+}
+
+__attribute__((target("avx2,popcnt")))
+static uint64_t grid_count8_avx2(const void *cells, size_t n, uint32_t value)
+{
+    const uint8_t *bytes = cells;
+    const __m256i wanted = _mm256_set1_epi8((char)value);
+    uint64_t count = 0;
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(bytes + i));
+        count += __builtin_popcount((uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, wanted)));
+    }
+    return count + grid_count8_scalar(bytes + i, n - i, value);
+}
+
+__attribute__((target("avx2")))
+static bool grid_any8_avx2(const void *cells, size_t n, uint32_t value)
+{
+    const uint8_t *bytes = cells;
+    const __m256i wanted = _mm256_set1_epi8((char)value);
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(bytes + i));
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, wanted))) {
+            return true;
+        }
+    }
+    return grid_any8_scalar(bytes + i, n - i, value);
+}
+
+__attribute__((target("avx2,popcnt")))
+static uint64_t grid_count32_avx2(const void *cells, size_t n, uint32_t value)
+{
+    const uint32_t *words = cells;
+    const __m256i wanted = _mm256_set1_epi32((int)value);
+    uint64_t count = 0;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(words + i));
+        count += __builtin_popcount((uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(v, wanted))));
+    }
+    return count + grid_count32_scalar(words + i, n - i, value);
+}
+
+__attribute__((target("avx2")))
+static bool grid_any32_avx2(const void *cells, size_t n, uint32_t value)
+{
+    const uint32_t *words = cells;
+    const __m256i wanted = _mm256_set1_epi32((int)value);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(words + i));
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(v, wanted))) {
+            return true;
+        }
+    }
+    return grid_any32_scalar(words + i, n - i, value);
+}
+
+const grid_kernels_t grid_kernels_sse2 = {
+    .count2 = grid_count2_sse2,
+    .count8 = grid_count8_sse2,
+    .count32 = grid_count32_sse2,
+    .any2 = grid_any2_sse2,
+    .any8 = grid_any8_sse2,
+    .any32 = grid_any32_sse2,
+};
+
+const grid_kernels_t grid_kernels_avx2 = {
+    .count2 = grid_count2_avx2,
+    .count8 = grid_count8_avx2,
+    .count32 = grid_count32_avx2,
+    .any2 = grid_any2_avx2,
+    .any8 = grid_any8_avx2,
+    .any32 = grid_any32_avx2,
+};
+
+#else
+
+const grid_kernels_t grid_kernels_sse2 = {
+    .count2 = grid_count2_scalar,
+    .count8 = grid_count8_scalar,
+    .count32 = grid_count32_scalar,
+    .any2 = grid_any2_scalar,
+    .any8 = grid_any8_scalar,
+    .any32 = grid_any32_scalar,
+};
+
+const grid_kernels_t grid_kernels_avx2 = {
+    .count2 = grid_count2_scalar,
+    .count8 = grid_count8_scalar,
+    .count32 = grid_count32_scalar,
+    .any2 = grid_any2_scalar,
+    .any8 = grid_any8_scalar,
+    .any32 = grid_any32_scalar,
+};
+
+#endif
+
+const grid_kernels_t *grid_kernels_select(void)
+{
+    if (cpu_has_avx2()) {
+        return &grid_kernels_avx2;
+    } else if (cpu_has_sse2()) {
+        return &grid_kernels_sse2;
+    } else {
+        return &grid_kernels_scalar;
+    }
+}
+
+static const grid_kernels_t *grid_kernels(void)
+{
+    static const grid_kernels_t *impl = NULL;
+    const grid_kernels_t *kernels = __atomic_load_n(&impl, __ATOMIC_RELAXED);
+    if (kernels == NULL) {
+        kernels = grid_kernels_select();
+        __atomic_store_n(&impl, kernels, __ATOMIC_RELAXED);
+    }
+    return kernels;
+}
+
+grid_t *grid_create(uint32_t width, uint32_t height, grid_cell_bits_t bits)
+{
+    if (bits != GRID_CELL_2 && bits != GRID_CELL_8 && bits != GRID_CELL_32) {
+        ERR("Bad cell width %u", bits);
+        return NULL;
+    }
+
+    size_t row_bytes = (((size_t)width * bits) + 7) / 8;
+    size_t stride = (row_bytes + GRID_ALIGNMENT - 1) & ~((size_t)GRID_ALIGNMENT - 1);
+    if (height != 0 && stride > (SIZE_MAX - GRID_ALIGNMENT) / height) {
+        ERR("Grid of %u x %u cells is too large", width, height);
+        return NULL;
+    }
+
+    grid_t *grid = calloc(1, sizeof(grid_t));
+    VALIDATE_PTR_OR_RETURN(grid, NULL);
+    grid->width = width;
+    grid->height = height;
+    grid->bits = bits;
+    grid->stride = stride;
+
+    // calloc keeps big grids lazily zeroed by the kernel; the cells are then
+    // aligned inside the block by hand.
+    grid->memory = calloc(1, grid_size(grid) + GRID_ALIGNMENT);
+    if (grid->memory == NULL) {
+        ERR("Could not allocate %zu bytes for a %u x %u grid", grid_size(grid), width, height);
+        free(grid);
+        return NULL;
+    }
+    uintptr_t base = ((uintptr_t)grid->memory + GRID_ALIGNMENT - 1) & ~((uintptr_t)GRID_ALIGNMENT - 1);
+    grid->cells = (uint8_t *)base;
+    return grid;
+}
+
+// Number of cells in row y, columns [x_begin, x_end), equal to value
+uint64_t grid_count_eq(grid_t *grid, uint32_t y, uint32_t x_begin, uint32_t x_end, uint32_t value)
+{
+    if (x_begin >= x_end) {
+        return 0;
+    }
+
+    const grid_kernels_t *kernels = grid_kernels();
+    switch (grid->bits) {
+        case GRID_CELL_2: {
+            // Cells sharing a byte with the edges of the span are done one
+            // at a time.
+            uint32_t first = (x_begin + 3) & ~3U;
+            uint32_t last = x_end & ~3U;
+            if (first >= last) {
+                uint64_t count = 0;
+                for (uint32_t x = x_begin; x < x_end; ++x) {
+                    count += (grid_get(grid, x, y) == value);
+                }
+                return count;
+            }
+
+            uint64_t count = kernels->count2(GRID_ROW(grid, uint8_t, y) + (first / 4), (last - first) / 4, value);
+            for (uint32_t x = x_begin; x < first; ++x) {
+                count += (grid_get(grid, x, y) == value);
+            }
+            for (uint32_t x = last; x < x_end; ++x) {
+                count += (grid_get(grid, x, y) == value);
+            }
+            return count;
+        }
+        case GRID_CELL_8:
+            return kernels->count8(GRID_ROW(grid, uint8_t, y) + x_begin, x_end - x_begin, value);
+        default:
+            return kernels->count32(GRID_ROW(grid, uint32_t, y) + x_begin, x_end - x_begin, value);
+    }
+}
+
+// Whether any cell in row y, columns [x_begin, x_end), equals value. Stops
+// at the first block holding one.
+bool grid_any_eq(grid_t *grid, uint32_t y, uint32_t x_begin, uint32_t x_end, uint32_t value)
+{
+    if (x_begin >= x_end) {
+        return false;
+    }
+
+    const grid_kernels_t *kernels = grid_kernels();
+    switch (grid->bits) {
+        case GRID_CELL_2: {
+            uint32_t first = (x_begin + 3) & ~3U;
+            uint32_t last = x_end & ~3U;
+            if (first >= last) {
+                for (uint32_t x = x_begin; x < x_end; ++x) {
+                    if (grid_get(grid, x, y) == value) {
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            for (uint32_t x = x_begin; x < first; ++x) {
+                if (grid_get(grid, x, y) == value) {
+                    return true;
+                }
+            }
+            for (uint32_t x = last; x < x_end; ++x) {
+                if (grid_get(grid, x, y) == value) {
+                    return true;
+                }
+            }
+            return kernels->any2(GRID_ROW(grid, uint8_t, y) + (first / 4), (last - first) / 4, value);
+        }
+        case GRID_CELL_8:
+            return kernels->any8(GRID_ROW(grid, uint8_t, y) + x_begin, x_end - x_begin, value);
+        default:
+            return kernels->any32(GRID_ROW(grid, uint32_t, y) + x_begin, x_end - x_begin, value);
+    }
+}
+
+void grid_clear(grid_t *grid)
+{
+    memset(grid->cells, 0, grid_size(grid));
+}
+
+void grid_free(grid_t *grid)
+{
+    if (grid) {
+        free(grid->memory);
+        free(grid);
+    }
+}
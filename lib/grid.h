@@ -0,0 +1,125 @@
+#ifndef GRID_H
+#define GRID_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Rows start on a cache line and are padded out to a whole number of them.
+#define GRID_ALIGNMENT (64)
+
+// Cells in a 2-bit grid are packed 32 to a 64-bit word, lowest bits first.
+#define GRID_CELLS_PER_WORD2 (32)
+
+// Supported cell widths, in bits
+typedef enum
+{
+    GRID_CELL_2 = 2,
+    GRID_CELL_8 = 8,
+    GRID_CELL_32 = 32,
+} grid_cell_bits_t;
+
+// A 2D grid of fixed-width cells in one zeroed allocation. Cell (x, y) is in
+// row y, which starts at cells + y * stride, so getting to it never goes
+// through a row pointer.
+typedef struct grid
+{
+    uint32_t width;
+    uint32_t height;
+    grid_cell_bits_t bits;
+    size_t stride;
+    uint8_t *cells;
+    void *memory;
+} grid_t;
+
+#define GRID_ROW(__g, __type, __y) ((__type *)((__g)->cells + ((size_t)(__y) * (__g)->stride)))
+#define GRID_AT(__g, __type, __x, __y) (GRID_ROW(__g, __type, __y)[(__x)])
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+static inline size_t grid_size(grid_t *grid)
+{
+    return grid->stride * grid->height;
+}
+
+// Number of 64-bit words in a row, padding included
+static inline size_t grid_row_words(grid_t *grid)
+{
+    return grid->stride / sizeof(uint64_t);
+}
+
+// Mask of the cells of a 2-bit word from first up to (not including) last,
+// both in [0, GRID_CELLS_PER_WORD2].
+static inline uint64_t grid_span_mask2(unsigned first, unsigned last)
+{
+    uint64_t high = (last == GRID_CELLS_PER_WORD2) ? ~0ULL : ((1ULL << (2 * last)) - 1);
+    uint64_t low = (1ULL << (2 * first)) - 1;
+    return high & ~low;
+}
+
+static inline uint32_t grid_get(grid_t *grid, uint32_t x, uint32_t y)
+{
+    switch (grid->bits) {
+        case GRID_CELL_2:
+            return (GRID_AT(grid, uint8_t, x / 4, y) >> (2 * (x % 4))) & 0x3;
+        case GRID_CELL_8:
+            return GRID_AT(grid, uint8_t, x, y);
+        default:
+            return GRID_AT(grid, uint32_t, x, y);
+    }
+}
+
+static inline void grid_set(grid_t *grid, uint32_t x, uint32_t y, uint32_t value)
+{
+    switch (grid->bits) {
+        case GRID_CELL_2: {
+            uint8_t *byte = &GRID_AT(grid, uint8_t, x / 4, y);
+            unsigned shift = 2 * (x % 4);
+            *byte = (uint8_t)((*byte & ~(0x3 << shift)) | ((value & 0x3) << shift));
+            break;
+        }
+        case GRID_CELL_8:
+            GRID_AT(grid, uint8_t, x, y) = (uint8_t)value;
+            break;
+        default:
+            GRID_AT(grid, uint32_t, x, y) = value;
+            break;
+    }
+}
+
+// Row kernels over whole units of a row: bytes of packed 2-bit cells (the
+// value is replicated into every cell of the byte), bytes of 8-bit cells or
+// 32-bit cells. grid_count_eq() and grid_any_eq() handle the ragged edges
+// and pick a kernel set for the CPU the first time they're called.
+typedef uint64_t (*grid_count_kernel_t)(const void *cells, size_t n, uint32_t value);
+typedef bool (*grid_any_kernel_t)(const void *cells, size_t n, uint32_t value);
+
+typedef struct grid_kernels
+{
+    grid_count_kernel_t count2;
+    grid_count_kernel_t count8;
+    grid_count_kernel_t count32;
+    grid_any_kernel_t any2;
+    grid_any_kernel_t any8;
+    grid_any_kernel_t any32;
+} grid_kernels_t;
+
+extern const grid_kernels_t grid_kernels_scalar;
+extern const grid_kernels_t grid_kernels_sse2;
+extern const grid_kernels_t grid_kernels_avx2;
+
+const grid_kernels_t *grid_kernels_select(void);
+
+grid_t *grid_create(uint32_t width, uint32_t height, grid_cell_bits_t bits);
+uint64_t grid_count_eq(grid_t *grid, uint32_t y, uint32_t x_begin, uint32_t x_end, uint32_t value);
+bool grid_any_eq(grid_t *grid, uint32_t y, uint32_t x_begin, uint32_t x_end, uint32_t value);
+void grid_clear(grid_t *grid);
+void grid_free(grid_t *grid);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
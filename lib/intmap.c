@@ -0,0 +1,138 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils.h"
+#include "intmap.h"
+
+// Fibonacci hashing: multiply by 2^64 / phi and keep the top bits.
+static inline size_t intmap_slot(intmap_t *map, int64_t key)
+{
+    return (size_t)(((uint64_t)key * 0x9E3779B97F4A7C15ULL) >> map->shift);
+}
+
+static bool intmap_alloc(intmap_t *map, size_t capacity)
+{
+    map->keys = malloc(capacity * sizeof(int64_t));
+    map->values = malloc(capacity * sizeof(uint32_t));
+    if (map->keys == NULL || map->values == NULL) {
+        free(map->keys);
+        free(map->values);
+        return false;
+    }
+
+    for (size_t i = 0; i < capacity; ++i) {
+        map->keys[i] = INTMAP_EMPTY_KEY;
+    }
+    map->capacity = capacity;
+    map->shift = 64 - __builtin_ctzll(capacity);
+    map->count = 0;
+    return true;
+}
+
+intmap_t *intmap_create(size_t expected)
+{
+    intmap_t *map = calloc(1, sizeof(intmap_t));
+    VALIDATE_PTR_OR_RETURN(map, NULL);
+
+    // Keep the load factor at or below one half.
+    size_t capacity = INTMAP_MIN_CAPACITY;
+    while (capacity < (2 * expected)) {
+        capacity *= 2;
+    }
+
+    if (!intmap_alloc(map, capacity)) {
+        free(map);
+        return NULL;
+    }
+    return map;
+}
+
+static void intmap_grow(intmap_t *map)
+{
+    int64_t *keys = map->keys;
+    uint32_t *values = map->values;
+    size_t capacity = map->capacity;
+    DIE_IF(!intmap_alloc(map, 2 * capacity), "Could not grow map to %zu slots", 2 * capacity);
+
+    for (size_t i = 0; i < capacity; ++i) {
+        if (keys[i] != INTMAP_EMPTY_KEY) {
+            size_t slot = intmap_slot(map, keys[i]);
+            while (map->keys[slot] != INTMAP_EMPTY_KEY) {
+                slot = (slot + 1) & (map->capacity - 1);
+            }
+            map->keys[slot] = keys[i];
+            map->values[slot] = values[i];
+            map->count++;
+        }
+    }
+    free(keys);
+    free(values);
+}
+
+bool intmap_lookup(intmap_t *map, int64_t key, uint32_t *value)
+{
+    if (key == INTMAP_EMPTY_KEY) {
+        if (map->has_empty_key && value) {
+            *value = map->empty_key_value;
+        }
+        return map->has_empty_key;
+    }
+
+    size_t slot = intmap_slot(map, key);
+    for (;;) {
+        int64_t k = map->keys[slot];
+        if (k == key) {
+            if (value) {
+                *value = map->values[slot];
+            }
+            return true;
+        } else if (k == INTMAP_EMPTY_KEY) {
+            return false;
+        }
+        slot = (slot + 1) & (map->capacity - 1);
+    }
+}
+
+// Returns the value stored for key, inserting (key, value) first if key
+// isn't in the map yet. *found says whether it was already there.
+uint32_t intmap_insert(intmap_t *map, int64_t key, uint32_t value, bool *found)
+{
+    if (key == INTMAP_EMPTY_KEY) {
+        *found = map->has_empty_key;
+        if (!map->has_empty_key) {
+            map->has_empty_key = true;
+            map->empty_key_value = value;
+        }
+        return map->empty_key_value;
+    }
+
+    if ((2 * (map->count + 1)) > map->capacity) {
+        intmap_grow(map);
+    }
+
+    size_t slot = intmap_slot(map, key);
+    for (;;) {
+        int64_t k = map->keys[slot];
+        if (k == key) {
+            *found = true;
+            return map->values[slot];
+        } else if (k == INTMAP_EMPTY_KEY) {
+            map->keys[slot] = key;
+            map->values[slot] = value;
+            map->count++;
+            *found = false;
+            return value;
+        }
+        slot = (slot + 1) & (map->capacity - 1);
+    }
+}
+
+void intmap_free(intmap_t *map)
+{
+    if (map) {
+        free(map->keys);
+        free(map->values);
+        free(map);
+    }
+}
@@ -0,0 +1,46 @@
+#ifndef INTMAP_H
+#define INTMAP_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Slots are empty when they hold this key. The key itself can still be
+// stored; it just lives outside the slot array.
+#define INTMAP_EMPTY_KEY INT64_MIN
+#define INTMAP_MIN_CAPACITY (16)
+
+// Open-addressing hash map from int64_t keys to uint32_t values with linear
+// probing. Keys and values sit in two flat arrays, so a probe sequence is a
+// walk along one cache line rather than a chain of pointers. Also used as a
+// plain set by ignoring the values.
+typedef struct intmap
+{
+    int64_t *keys;
+    uint32_t *values;
+    size_t capacity;
+    size_t count;
+    unsigned shift;
+    bool has_empty_key;
+    uint32_t empty_key_value;
+} intmap_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+static inline size_t intmap_count(intmap_t *map)
+{
+    return map->count + (map->has_empty_key ? 1 : 0);
+}
+
+intmap_t *intmap_create(size_t expected);
+bool intmap_lookup(intmap_t *map, int64_t key, uint32_t *value);
+uint32_t intmap_insert(intmap_t *map, int64_t key, uint32_t value, bool *found);
+void intmap_free(intmap_t *map);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
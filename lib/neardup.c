@@ -0,0 +1,240 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils.h"
+#include "sort.h"
+#include "text.h"
+#include "neardup.h"
+
+// Strings are hashed as sum(s[i] * B^(len - 1 - i)) mod 2^64, so taking one
+// position out of a hash is a single multiply and subtract. Equal hashes are
+// only candidates; every pair is checked against the strings themselves.
+#define NEARDUP_HASH_BASE (0x100000001B3ULL)
+
+typedef struct neardup_entry
+{
+    uint64_t hash;
+    size_t index;
+} neardup_entry_t;
+
+typedef struct neardup_search
+{
+    line_t **lines;
+    size_t max_distance;
+    neardup_visit_t visit;
+    void *ctx;
+    size_t reported;
+    bool stopped;
+} neardup_search_t;
+
+static uint64_t neardup_mix(uint64_t hash)
+{
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDULL;
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+static uint64_t neardup_hash(const char *str, size_t len)
+{
+    uint64_t hash = 0;
+    for (size_t i = 0; i < len; ++i) {
+        hash = (hash * NEARDUP_HASH_BASE) + (unsigned char)str[i];
+    }
+    return hash;
+}
+
+static uint64_t neardup_entry_key(const void *elem, void *ctx)
+{
+    return ((const neardup_entry_t *)elem)->hash;
+}
+
+static void neardup_report(neardup_search_t *search, size_t a, size_t b, size_t distance)
+{
+    search->reported++;
+    if (!search->visit(a, b, distance, search->ctx)) {
+        search->stopped = true;
+    }
+}
+
+// Sorts one pass worth of entries and hands every group of equal hashes to
+// the pass's pair check.
+static void neardup_buckets(neardup_search_t *search, neardup_entry_t *entries, size_t count, size_t pass,
+                            void (*check)(neardup_search_t *, size_t, size_t, size_t))
+{
+    sort_radix(entries, count, sizeof(entries[0]), neardup_entry_key, NULL);
+
+    size_t start = 0;
+    while (start < count && !search->stopped) {
+        size_t end = start + 1;
+        while (end < count && entries[end].hash == entries[start].hash) {
+            end++;
+        }
+
+        // The sort is stable and entries go in by index, so a < b here.
+        for (size_t i = start; i < end && !search->stopped; ++i) {
+            for (size_t j = i + 1; j < end && !search->stopped; ++j) {
+                check(search, entries[i].index, entries[j].index, pass);
+            }
+        }
+        start = end;
+    }
+}
+
+static void neardup_check_masked(neardup_search_t *search, size_t a, size_t b, size_t position)
+{
+    line_t *l1 = search->lines[a];
+    line_t *l2 = search->lines[b];
+    if (l1->len != l2->len
+        || memcmp(l1->str, l2->str, position) != 0
+        || memcmp(l1->str + position + 1, l2->str + position + 1, l1->len - position - 1) != 0) {
+        return;
+    }
+
+    // Identical strings collide at every position; only report them once.
+    if (l1->str[position] != l2->str[position]) {
+        if (search->max_distance >= 1) {
+            neardup_report(search, a, b, 1);
+        }
+    } else if (position == 0) {
+        neardup_report(search, a, b, 0);
+    }
+}
+
+static void neardup_masked(neardup_search_t *search, size_t n)
+{
+    size_t longest = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (search->lines[i]->len > longest) {
+            longest = search->lines[i]->len;
+        }
+    }
+
+    uint64_t *hashes = malloc(n * sizeof(uint64_t));
+    uint64_t *powers = malloc((longest + 1) * sizeof(uint64_t));
+    neardup_entry_t *entries = malloc(n * sizeof(neardup_entry_t));
+    DIE_IF((hashes == NULL || powers == NULL || entries == NULL), "Could not allocate index for %zu strings", n);
+
+    powers[0] = 1;
+    for (size_t i = 1; i <= longest; ++i) {
+        powers[i] = powers[i - 1] * NEARDUP_HASH_BASE;
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        hashes[i] = neardup_hash(search->lines[i]->str, search->lines[i]->len);
+    }
+
+    for (size_t position = 0; position < longest && !search->stopped; ++position) {
+        size_t count = 0;
+        for (size_t i = 0; i < n; ++i) {
+            line_t *line = search->lines[i];
+            if (line->len <= position) {
+                continue;
+            }
+
+            uint64_t masked = hashes[i] - ((unsigned char)line->str[position] * powers[line->len - 1 - position]);
+            entries[count].hash = neardup_mix(masked ^ (line->len * NEARDUP_HASH_BASE));
+            entries[count].index = i;
+            count++;
+        }
+
+        neardup_buckets(search, entries, count, position, neardup_check_masked);
+    }
+
+    free(entries);
+    free(powers);
+    free(hashes);
+}
+
+static size_t neardup_segment_start(size_t len, size_t segment, size_t nsegments)
+{
+    return (len * segment) / nsegments;
+}
+
+static void neardup_check_segment(neardup_search_t *search, size_t a, size_t b, size_t segment)
+{
+    line_t *l1 = search->lines[a];
+    line_t *l2 = search->lines[b];
+    if (l1->len != l2->len) {
+        return;
+    }
+
+    size_t distance = text_hamming(l1->str, l2->str, l1->len);
+    if (distance > search->max_distance) {
+        return;
+    }
+
+    // The pair turns up again for every segment it agrees on, so it's only
+    // reported for the first of them.
+    size_t nsegments = search->max_distance + 1;
+    for (size_t s = 0; s < segment; ++s) {
+        size_t from = neardup_segment_start(l1->len, s, nsegments);
+        size_t to = neardup_segment_start(l1->len, s + 1, nsegments);
+        if (memcmp(l1->str + from, l2->str + from, to - from) == 0) {
+            return;
+        }
+    }
+
+    neardup_report(search, a, b, distance);
+}
+
+static void neardup_segments(neardup_search_t *search, size_t n)
+{
+    neardup_entry_t *entries = malloc(n * sizeof(neardup_entry_t));
+    DIE_IF((entries == NULL), "Could not allocate index for %zu strings", n);
+
+    size_t nsegments = search->max_distance + 1;
+    for (size_t segment = 0; segment < nsegments && !search->stopped; ++segment) {
+        for (size_t i = 0; i < n; ++i) {
+            line_t *line = search->lines[i];
+            size_t from = neardup_segment_start(line->len, segment, nsegments);
+            size_t to = neardup_segment_start(line->len, segment + 1, nsegments);
+            uint64_t hash = neardup_hash(line->str + from, to - from);
+            entries[i].hash = neardup_mix(hash ^ (line->len * NEARDUP_HASH_BASE));
+            entries[i].index = i;
+        }
+
+        neardup_buckets(search, entries, n, segment, neardup_check_segment);
+    }
+
+    free(entries);
+}
+
+// Finds every pair of lines within max_distance of each other and returns
+// how many were reported. Each pass is a radix sort plus a walk over
+// groups of equal hashes, so the work is O(n * len) on top of the pairs
+// themselves. Empty lines are skipped by the masked search.
+size_t neardup_find(line_t **lines, size_t n, size_t max_distance, neardup_mode_t mode, neardup_visit_t visit, void *ctx)
+{
+    VALIDATE_PTR_OR_RETURN(lines, 0);
+    VALIDATE_PTR_OR_RETURN(visit, 0);
+
+    if (mode == NEARDUP_AUTO) {
+        mode = (max_distance == 1) ? NEARDUP_MASKED : NEARDUP_SEGMENTS;
+    }
+
+    if (mode == NEARDUP_MASKED && max_distance > 1) {
+        ERR("Masked search only finds pairs up to distance 1, not %zu", max_distance);
+        return 0;
+    }
+
+    neardup_search_t search = {
+        .lines = lines,
+        .max_distance = max_distance,
+        .visit = visit,
+        .ctx = ctx,
+        .reported = 0,
+        .stopped = false,
+    };
+
+    if (mode == NEARDUP_MASKED) {
+        neardup_masked(&search, n);
+    } else {
+        neardup_segments(&search, n);
+    }
+
+    return search.reported;
+}
@@ -0,0 +1,36 @@
+#ifndef NEARDUP_H
+#define NEARDUP_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "file.h"
+
+typedef enum
+{
+    // Masked positions for distance 1, segments for anything else
+    NEARDUP_AUTO = 0,
+    // Hash every string once per position with that position left out.
+    // Only works for distances up to 1.
+    NEARDUP_MASKED,
+    // Split every string into max_distance + 1 segments and bucket on each;
+    // two strings within the distance must agree on at least one of them.
+    NEARDUP_SEGMENTS,
+} neardup_mode_t;
+
+// Called once per unordered pair (a < b) of equal-length lines at Hamming
+// distance <= max_distance. Return false to stop the search.
+typedef bool (*neardup_visit_t)(size_t a, size_t b, size_t distance, void *ctx);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+size_t neardup_find(line_t **lines, size_t n, size_t max_distance, neardup_mode_t mode, neardup_visit_t visit, void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,59 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "utils.h"
+#include "parallel.h"
+
+struct parallel_thread {
+    pthread_t thread;
+    bool started;
+    parallel_task_t task;
+    void *ctx;
+    size_t index;
+    size_t count;
+};
+
+size_t parallel_default_threads(void)
+{
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    return (online > 0) ? (size_t)online : 1;
+}
+
+static void *parallel_thread_main(void *arg)
+{
+    struct parallel_thread *t = arg;
+    t->task(t->ctx, t->index, t->count);
+    return NULL;
+}
+
+void parallel_for(size_t count, parallel_task_t task, void *ctx)
+{
+    if (count == 0) {
+        return;
+    } else if (count == 1) {
+        task(ctx, 0, 1);
+        return;
+    }
+
+    struct parallel_thread *threads = calloc(count, sizeof(struct parallel_thread));
+    DIE_IF((threads == NULL), "Could not allocate %zu threads", count);
+    for (size_t i = 1; i < count; ++i) {
+        threads[i] = (struct parallel_thread){ .task = task, .ctx = ctx, .index = i, .count = count };
+        threads[i].started = (pthread_create(&threads[i].thread, NULL, parallel_thread_main, &threads[i]) == 0);
+    }
+
+    task(ctx, 0, count);
+
+    // Anything that couldn't get a thread of its own runs here instead.
+    for (size_t i = 1; i < count; ++i) {
+        if (threads[i].started) {
+            pthread_join(threads[i].thread, NULL);
+        } else {
+            task(ctx, i, count);
+        }
+    }
+    free(threads);
+}
@@ -0,0 +1,22 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <stddef.h>
+
+// Runs task(ctx, index, count) once for every index in [0, count), each on
+// its own thread (index 0 runs on the calling thread), and returns when all
+// of them have finished.
+typedef void (*parallel_task_t)(void *ctx, size_t index, size_t count);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+size_t parallel_default_threads(void);
+void parallel_for(size_t count, parallel_task_t task, void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
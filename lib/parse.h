@@ -0,0 +1,293 @@
+#ifndef PARSE_H
+#define PARSE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdbool.h>
+
+// Small locale-free parsing primitives for the fixed input formats. They all
+// work on a cursor (*s) bounded by end and advance it past what they consume,
+// so a record parser is just a chain of calls with no format string to
+// interpret on every line.
+
+typedef struct parse_timestamp
+{
+    uint32_t year;
+    uint32_t month;
+    uint32_t day;
+    uint32_t hour;
+    uint32_t minute;
+} parse_timestamp_t;
+
+// Length of "[YYYY-MM-DD HH:MM]"
+#define PARSE_TIMESTAMP_LENGTH (18)
+
+// A timestamp packed into one integer that sorts in time order, most
+// significant field first:
+// year (14 bits) | month (4) | day (5) | hour (5) | minute (6)
+#define PARSE_TIMESTAMP_MINUTE_BITS (6)
+#define PARSE_TIMESTAMP_HOUR_SHIFT (6)
+#define PARSE_TIMESTAMP_DAY_SHIFT (11)
+#define PARSE_TIMESTAMP_MONTH_SHIFT (16)
+#define PARSE_TIMESTAMP_YEAR_SHIFT (20)
+
+#define PARSE_TIMESTAMP_MINUTE(__key) ((uint32_t)((__key) & ((1U << PARSE_TIMESTAMP_MINUTE_BITS) - 1)))
+#define PARSE_TIMESTAMP_HOUR(__key) ((uint32_t)(((__key) >> PARSE_TIMESTAMP_HOUR_SHIFT) & 0x1F))
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+static inline bool parse_is_digit(char c)
+{
+    return ((unsigned char)(c - '0')) < 10;
+}
+
+// Moves *s to the next digit. Returns false if there isn't one before end.
+static inline bool parse_skip_to_digit(const char **s, const char *end)
+{
+    const char *p = *s;
+    while (p < end && !parse_is_digit(*p)) {
+        p++;
+    }
+    *s = p;
+    return (p < end);
+}
+
+// Parses a run of decimal digits (no base prefixes). Returns false if *s
+// isn't at a digit or the number doesn't fit in 64 bits.
+static inline bool parse_uint64(const char **s, const char *end, uint64_t *out)
+{
+    const char *p = *s;
+    if (p >= end || !parse_is_digit(*p)) {
+        return false;
+    }
+
+    uint64_t value = 0;
+    while (p < end) {
+        unsigned digit = (unsigned char)(*p - '0');
+        if (digit > 9) {
+            break;
+        }
+        if (__builtin_mul_overflow(value, 10, &value) || __builtin_add_overflow(value, digit, &value)) {
+            return false;
+        }
+        p++;
+    }
+
+    *out = value;
+    *s = p;
+    return true;
+}
+
+// Number of leading decimal digits in the 8 bytes of v (in memory order on
+// a little-endian machine). A byte is a digit if neither b - '0' nor
+// b + (0x7F - '9') sets its top bit; borrows and carries only run towards
+// later bytes, so the first non-digit is always flagged correctly.
+static inline unsigned parse_digit_run8(uint64_t v)
+{
+    uint64_t flags = ((v - 0x3030303030303030ULL) | (v + 0x4646464646464646ULL)) & 0x8080808080808080ULL;
+    return flags ? (__builtin_ctzll(flags) / 8) : 8;
+}
+
+// Converts the first n (1-8) digits of v in one go: the digits are shifted up
+// so missing ones read as leading zeros, then adjacent pairs, quads and
+// octets are combined with three multiplies.
+static inline uint64_t parse_digits8(uint64_t v, unsigned n)
+{
+    v = (v & 0x0F0F0F0F0F0F0F0FULL) << (8 * (8 - n));
+    v = (v * 2561) >> 8;
+    v = ((v & 0x00FF00FF00FF00FFULL) * 6553601) >> 16;
+    return ((v & 0x0000FFFF0000FFFFULL) * 42949672960001ULL) >> 32;
+}
+
+// Same as parse_uint64() but consumes up to eight digits per step while at
+// least eight bytes remain before end. Also rejects numbers that overflow.
+static inline bool parse_uint64_swar(const char **s, const char *end, uint64_t *out)
+{
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+    const char *p = *s;
+    uint64_t value = 0;
+    bool any = false;
+    while ((end - p) >= 8) {
+        uint64_t v;
+        memcpy(&v, p, sizeof(v));
+        unsigned n = parse_digit_run8(v);
+        if (n == 0) {
+            break;
+        }
+
+        static const uint64_t scale[9] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000 };
+        if (__builtin_mul_overflow(value, scale[n], &value) || __builtin_add_overflow(value, parse_digits8(v, n), &value)) {
+            return false;
+        }
+        p += n;
+        any = true;
+        if (n < 8) {
+            *out = value;
+            *s = p;
+            return true;
+        }
+    }
+
+    // Fewer than eight bytes left: finish off with the plain loop.
+    uint64_t rest = 0;
+    const char *q = p;
+    if (parse_uint64(&q, end, &rest)) {
+        uint64_t factor = 1;
+        for (const char *d = p; d < q; ++d) {
+            factor *= 10;
+        }
+        if (__builtin_mul_overflow(value, factor, &value) || __builtin_add_overflow(value, rest, &value)) {
+            return false;
+        }
+        p = q;
+        any = true;
+    }
+
+    if (!any) {
+        return false;
+    }
+    *out = value;
+    *s = p;
+    return true;
+#else
+    return parse_uint64(s, end, out);
+#endif
+}
+
+static inline const char *parse_sign(const char *p, const char *end, bool *negative)
+{
+    *negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        *negative = (*p == '-');
+        p++;
+    }
+    return p;
+}
+
+// Whether magnitude fits once the sign is applied; INT64_MIN has no positive
+// counterpart.
+static inline bool parse_fits_int64(uint64_t magnitude, bool negative)
+{
+    return magnitude <= ((uint64_t)INT64_MAX + negative);
+}
+
+// Branch-free negate: (m ^ 0) - 0 == m and (m ^ ~0) - ~0 == -m
+static inline int64_t parse_apply_sign(uint64_t magnitude, bool negative)
+{
+    uint64_t mask = -(uint64_t)negative;
+    return (int64_t)((magnitude ^ mask) - mask);
+}
+
+// Parses an optionally signed ('+' or '-') decimal integer. Values outside
+// the range of int64_t are rejected rather than clamped.
+static inline bool parse_int64(const char **s, const char *end, int64_t *out)
+{
+    bool negative = false;
+    const char *p = parse_sign(*s, end, &negative);
+    uint64_t magnitude = 0;
+    if (!parse_uint64(&p, end, &magnitude) || !parse_fits_int64(magnitude, negative)) {
+        return false;
+    }
+
+    *out = parse_apply_sign(magnitude, negative);
+    *s = p;
+    return true;
+}
+
+static inline bool parse_int64_swar(const char **s, const char *end, int64_t *out)
+{
+    bool negative = false;
+    const char *p = parse_sign(*s, end, &negative);
+    uint64_t magnitude = 0;
+    if (!parse_uint64_swar(&p, end, &magnitude) || !parse_fits_int64(magnitude, negative)) {
+        return false;
+    }
+
+    *out = parse_apply_sign(magnitude, negative);
+    *s = p;
+    return true;
+}
+
+static inline bool parse_is_space(char c)
+{
+    return (c == ' ' || c == '\n' || c == '\r' || c == '\t');
+}
+
+// Skips to the next digit and parses the unsigned number there, for formats
+// where the numbers are separated by fixed punctuation.
+static inline bool parse_next_uint32(const char **s, const char *end, uint32_t *out)
+{
+    uint64_t value = 0;
+    if (!parse_skip_to_digit(s, end) || !parse_uint64(s, end, &value) || value > UINT32_MAX) {
+        return false;
+    }
+    *out = (uint32_t)value;
+    return true;
+}
+
+// Consumes prefix if the text at *s starts with it.
+static inline bool parse_match(const char **s, const char *end, const char *prefix)
+{
+    size_t len = strlen(prefix);
+    if ((size_t)(end - *s) < len || memcmp(*s, prefix, len) != 0) {
+        return false;
+    }
+    *s += len;
+    return true;
+}
+
+// Parses a fixed-layout "[YYYY-MM-DD HH:MM]". Every digit is at a known
+// offset, so the fields are plain arithmetic and the validity check is one
+// OR over all twelve digits. Fields out of their calendar range (month
+// 1-12, day 1-31, hour 0-23, minute 0-59) are rejected too, since they
+// would spill into the next field of a packed timestamp.
+static inline bool parse_timestamp(const char **s, const char *end, parse_timestamp_t *ts)
+{
+    const unsigned char *p = (const unsigned char *)*s;
+    if ((end - *s) < PARSE_TIMESTAMP_LENGTH || p[0] != '[' || p[5] != '-' || p[8] != '-' || p[11] != ' ' || p[14] != ':' || p[17] != ']') {
+        return false;
+    }
+
+#define PARSE_DIGIT(__i) ((unsigned)(p[(__i)] - '0'))
+    unsigned bad = 0;
+    static const int digits[] = { 1, 2, 3, 4, 6, 7, 9, 10, 12, 13, 15, 16 };
+    for (size_t i = 0; i < sizeof(digits) / sizeof(digits[0]); ++i) {
+        bad |= (PARSE_DIGIT(digits[i]) > 9);
+    }
+    if (bad) {
+        return false;
+    }
+
+    unsigned month = (PARSE_DIGIT(6) * 10) + PARSE_DIGIT(7);
+    unsigned day = (PARSE_DIGIT(9) * 10) + PARSE_DIGIT(10);
+    unsigned hour = (PARSE_DIGIT(12) * 10) + PARSE_DIGIT(13);
+    unsigned minute = (PARSE_DIGIT(15) * 10) + PARSE_DIGIT(16);
+    if ((month - 1) > 11 || (day - 1) > 30 || hour > 23 || minute > 59) {
+        return false;
+    }
+
+    ts->year = (PARSE_DIGIT(1) * 1000) + (PARSE_DIGIT(2) * 100) + (PARSE_DIGIT(3) * 10) + PARSE_DIGIT(4);
+    ts->month = month;
+    ts->day = day;
+    ts->hour = hour;
+    ts->minute = minute;
+#undef PARSE_DIGIT
+
+    *s += PARSE_TIMESTAMP_LENGTH;
+    return true;
+}
+
+static inline uint64_t parse_timestamp_pack(const parse_timestamp_t *ts)
+{
+    return ((uint64_t)ts->year << PARSE_TIMESTAMP_YEAR_SHIFT) | ((uint64_t)ts->month << PARSE_TIMESTAMP_MONTH_SHIFT) |
+        ((uint64_t)ts->day << PARSE_TIMESTAMP_DAY_SHIFT) | ((uint64_t)ts->hour << PARSE_TIMESTAMP_HOUR_SHIFT) | ts->minute;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,376 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "utils.h"
+#include "parallel.h"
+#include "pool.h"
+
+#define POOL_DEQUE_INITIAL (16)
+
+// Not a worker of any pool; such threads can only steal.
+#define POOL_OUTSIDE (SIZE_MAX)
+
+struct pool_worker {
+    pool_t *pool;
+    size_t index;
+    pthread_t thread;
+    bool started;
+};
+
+// The worker, if any, that the current thread is.
+static __thread pool_t *pool_current;
+static __thread size_t pool_current_index;
+
+static bool pool_deque_init(pool_deque_t *deque)
+{
+    deque->tasks = malloc(POOL_DEQUE_INITIAL * sizeof(pool_future_t *));
+    VALIDATE_PTR_OR_RETURN(deque->tasks, false);
+    deque->head = 0;
+    deque->count = 0;
+    deque->capacity = POOL_DEQUE_INITIAL;
+    pthread_mutex_init(&deque->lock, NULL);
+    return true;
+}
+
+static void pool_deque_destroy(pool_deque_t *deque)
+{
+    if (deque->tasks) {
+        pthread_mutex_destroy(&deque->lock);
+        free(deque->tasks);
+    }
+}
+
+static bool pool_deque_push(pool_deque_t *deque, pool_future_t *future)
+{
+    bool pushed = true;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->count == deque->capacity) {
+        // Unroll the ring into a buffer twice the size.
+        pool_future_t **tasks = malloc(2 * deque->capacity * sizeof(pool_future_t *));
+        if (tasks == NULL) {
+            ERR("Could not grow a deque past %zu tasks", deque->capacity);
+            pushed = false;
+        } else {
+            for (size_t i = 0; i < deque->count; ++i) {
+                tasks[i] = deque->tasks[(deque->head + i) % deque->capacity];
+            }
+            free(deque->tasks);
+            deque->tasks = tasks;
+            deque->head = 0;
+            deque->capacity *= 2;
+        }
+    }
+    if (pushed) {
+        deque->tasks[(deque->head + deque->count) % deque->capacity] = future;
+        deque->count++;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return pushed;
+}
+
+// Newest task, for the owner
+static pool_future_t *pool_deque_pop(pool_deque_t *deque)
+{
+    pool_future_t *future = NULL;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->count > 0) {
+        deque->count--;
+        future = deque->tasks[(deque->head + deque->count) % deque->capacity];
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return future;
+}
+
+// Oldest task, for everyone else
+static pool_future_t *pool_deque_steal(pool_deque_t *deque)
+{
+    pool_future_t *future = NULL;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->count > 0) {
+        future = deque->tasks[deque->head];
+        deque->head = (deque->head + 1) % deque->capacity;
+        deque->count--;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return future;
+}
+
+static size_t pool_self(pool_t *pool)
+{
+    return (pool_current == pool) ? pool_current_index : POOL_OUTSIDE;
+}
+
+// Takes a task from self's own deque if it has one, otherwise steals one,
+// starting with the deque after self's so thieves spread out.
+static pool_future_t *pool_take(pool_t *pool, size_t self)
+{
+    pool_future_t *future = NULL;
+    size_t first = 0;
+    if (self != POOL_OUTSIDE) {
+        future = pool_deque_pop(&pool->deques[self]);
+        first = self + 1;
+    }
+    for (size_t i = 0; future == NULL && i < pool->nthreads; ++i) {
+        future = pool_deque_steal(&pool->deques[(first + i) % pool->nthreads]);
+    }
+
+    if (future) {
+        __atomic_fetch_sub(&pool->queued, 1, __ATOMIC_RELAXED);
+    }
+    return future;
+}
+
+static void pool_run(pool_t *pool, pool_future_t *future)
+{
+    future->task(future->ctx, future->result);
+    __atomic_store_n(&future->done, true, __ATOMIC_RELEASE);
+
+    pthread_mutex_lock(&pool->lock);
+    pthread_cond_broadcast(&pool->changed);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+static void *pool_worker_main(void *arg)
+{
+    struct pool_worker *worker = arg;
+    pool_t *pool = worker->pool;
+    pool_current = pool;
+    pool_current_index = worker->index;
+
+    for (;;) {
+        pool_future_t *future = pool_take(pool, worker->index);
+        if (future) {
+            pool_run(pool, future);
+            continue;
+        }
+
+        // Anything still queued when the pool is freed gets run first.
+        pthread_mutex_lock(&pool->lock);
+        while (!pool->stopping && __atomic_load_n(&pool->queued, __ATOMIC_RELAXED) == 0) {
+            pthread_cond_wait(&pool->changed, &pool->lock);
+        }
+        bool stop = pool->stopping && __atomic_load_n(&pool->queued, __ATOMIC_RELAXED) == 0;
+        pthread_mutex_unlock(&pool->lock);
+        if (stop) {
+            return NULL;
+        }
+    }
+}
+
+// nthreads of 0 means one per CPU. If some of the threads can't be started
+// the pool still works; whoever waits on a future picks up the slack.
+pool_t *pool_create(size_t nthreads)
+{
+    if (nthreads == 0) {
+        nthreads = parallel_default_threads();
+    }
+
+    pool_t *pool = calloc(1, sizeof(pool_t));
+    VALIDATE_PTR_OR_RETURN(pool, NULL);
+    pool->nthreads = nthreads;
+    pool->deques = calloc(nthreads, sizeof(pool_deque_t));
+    pool->workers = calloc(nthreads, sizeof(struct pool_worker));
+    if (pool->deques == NULL || pool->workers == NULL) {
+        ERR("Could not allocate a pool of %zu threads", nthreads);
+        free(pool->workers);
+        free(pool->deques);
+        free(pool);
+        return NULL;
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->changed, NULL);
+    for (size_t i = 0; i < nthreads; ++i) {
+        if (!pool_deque_init(&pool->deques[i])) {
+            pool->nthreads = i;
+            pool_free(pool);
+            return NULL;
+        }
+    }
+
+    for (size_t i = 0; i < nthreads; ++i) {
+        pool->workers[i] = (struct pool_worker){ .pool = pool, .index = i };
+        pool->workers[i].started = (pthread_create(&pool->workers[i].thread, NULL, pool_worker_main, &pool->workers[i]) == 0);
+    }
+    return pool;
+}
+
+// Queues task(ctx, result) with result_size bytes of result storage. The
+// future has to be waited on before it's freed.
+pool_future_t *pool_submit(pool_t *pool, pool_task_t task, void *ctx, size_t result_size)
+{
+    pool_future_t *future = calloc(1, sizeof(pool_future_t) + result_size);
+    VALIDATE_PTR_OR_RETURN(future, NULL);
+    future->task = task;
+    future->ctx = ctx;
+    future->result_size = result_size;
+
+    size_t self = pool_self(pool);
+    if (self == POOL_OUTSIDE) {
+        self = __atomic_fetch_add(&pool->next_deque, 1, __ATOMIC_RELAXED) % pool->nthreads;
+    }
+
+    // Counted before it's visible, so queued never drops below the number of
+    // tasks actually sitting in the deques.
+    __atomic_fetch_add(&pool->queued, 1, __ATOMIC_RELAXED);
+    if (!pool_deque_push(&pool->deques[self], future)) {
+        __atomic_fetch_sub(&pool->queued, 1, __ATOMIC_RELAXED);
+        free(future);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pthread_cond_broadcast(&pool->changed);
+    pthread_mutex_unlock(&pool->lock);
+    return future;
+}
+
+// Returns the future's result once its task has run, running other queued
+// tasks until then.
+void *pool_wait(pool_t *pool, pool_future_t *future)
+{
+    size_t self = pool_self(pool);
+    while (!__atomic_load_n(&future->done, __ATOMIC_ACQUIRE)) {
+        pool_future_t *other = pool_take(pool, self);
+        if (other) {
+            pool_run(pool, other);
+            continue;
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        while (!__atomic_load_n(&future->done, __ATOMIC_ACQUIRE) && __atomic_load_n(&pool->queued, __ATOMIC_RELAXED) == 0) {
+            pthread_cond_wait(&pool->changed, &pool->lock);
+        }
+        pthread_mutex_unlock(&pool->lock);
+    }
+    return future->result;
+}
+
+void pool_future_free(pool_future_t *future)
+{
+    free(future);
+}
+
+struct pool_reduce_job {
+    pool_map_t map;
+    pool_merge_t merge;
+    void *ctx;
+};
+
+struct pool_reduce_chunk {
+    struct pool_reduce_job *job;
+    size_t begin;
+    size_t end;
+    pool_future_t *future;
+    void *right;
+};
+
+static void pool_reduce_map_task(void *ctx, void *result)
+{
+    struct pool_reduce_chunk *chunk = ctx;
+    chunk->job->map(chunk->job->ctx, chunk->begin, chunk->end, result);
+}
+
+// Merges the right neighbour's result into this chunk's own.
+static void pool_reduce_merge_task(void *ctx, void *result)
+{
+    struct pool_reduce_chunk *chunk = ctx;
+    chunk->job->merge(chunk->job->ctx, chunk->future->result, chunk->right);
+}
+
+// Waits out and frees futures[0, count), skipping any that never got
+// submitted.
+static void pool_wait_all(pool_t *pool, pool_future_t **futures, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        if (futures[i]) {
+            pool_wait(pool, futures[i]);
+            pool_future_free(futures[i]);
+            futures[i] = NULL;
+        }
+    }
+}
+
+// Splits [0, count) into nchunks ranges (0 means one per thread), maps each
+// of them as its own task, then merges neighbouring results pairwise, a
+// level at a time, until one is left in result.
+bool pool_reduce(pool_t *pool, size_t count, size_t nchunks, pool_map_t map, pool_merge_t merge, void *ctx, void *result, size_t result_size)
+{
+    if (nchunks == 0) {
+        nchunks = pool->nthreads;
+    }
+    if (nchunks > count) {
+        nchunks = count ? count : 1;
+    }
+
+    struct pool_reduce_job job = { .map = map, .merge = merge, .ctx = ctx };
+    struct pool_reduce_chunk *chunks = calloc(nchunks, sizeof(struct pool_reduce_chunk));
+    pool_future_t **merges = calloc(nchunks, sizeof(pool_future_t *));
+    if (chunks == NULL || merges == NULL) {
+        ERR("Could not allocate a reduction of %zu chunks", nchunks);
+        free(merges);
+        free(chunks);
+        return false;
+    }
+
+    bool ok = true;
+    for (size_t i = 0; ok && i < nchunks; ++i) {
+        chunks[i].job = &job;
+        chunks[i].begin = (count * i) / nchunks;
+        chunks[i].end = (count * (i + 1)) / nchunks;
+        chunks[i].future = pool_submit(pool, pool_reduce_map_task, &chunks[i], result_size);
+        ok = (chunks[i].future != NULL);
+    }
+    for (size_t i = 0; ok && i < nchunks; ++i) {
+        pool_wait(pool, chunks[i].future);
+    }
+
+    for (size_t stride = 1; ok && stride < nchunks; stride *= 2) {
+        for (size_t i = 0; ok && i + stride < nchunks; i += 2 * stride) {
+            chunks[i].right = chunks[i + stride].future->result;
+            merges[i] = pool_submit(pool, pool_reduce_merge_task, &chunks[i], 0);
+            ok = (merges[i] != NULL);
+        }
+        pool_wait_all(pool, merges, nchunks);
+    }
+
+    if (ok) {
+        memcpy(result, chunks[0].future->result, result_size);
+    }
+    for (size_t i = 0; i < nchunks; ++i) {
+        if (chunks[i].future) {
+            pool_wait(pool, chunks[i].future);
+            pool_future_free(chunks[i].future);
+        }
+    }
+    free(merges);
+    free(chunks);
+    return ok;
+}
+
+void pool_free(pool_t *pool)
+{
+    if (pool) {
+        if (pool->workers) {
+            pthread_mutex_lock(&pool->lock);
+            pool->stopping = true;
+            pthread_cond_broadcast(&pool->changed);
+            pthread_mutex_unlock(&pool->lock);
+            for (size_t i = 0; i < pool->nthreads; ++i) {
+                if (pool->workers[i].started) {
+                    pthread_join(pool->workers[i].thread, NULL);
+                }
+            }
+        }
+        for (size_t i = 0; i < pool->nthreads; ++i) {
+            pool_deque_destroy(&pool->deques[i]);
+        }
+        pthread_cond_destroy(&pool->changed);
+        pthread_mutex_destroy(&pool->lock);
+        free(pool->workers);
+        free(pool->deques);
+        free(pool);
+    }
+}
@@ -0,0 +1,75 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+// A task writes its answer into result, which is the result_size bytes of
+// storage its future was submitted with.
+typedef void (*pool_task_t)(void *ctx, void *result);
+
+// pool_reduce() callbacks: map reduces [begin, end) into a result, merge
+// folds the result of the range just to the right of left into left. merge
+// has to be associative, since results are merged pairwise in a tree.
+typedef void (*pool_map_t)(void *ctx, size_t begin, size_t end, void *result);
+typedef void (*pool_merge_t)(void *ctx, void *left, const void *right);
+
+// A submitted task and, once it has run, its result. The result lives in
+// the future itself and is read back through POOL_WAIT() as its real type.
+typedef struct pool_future
+{
+    pool_task_t task;
+    void *ctx;
+    bool done;
+    size_t result_size;
+    max_align_t result[];
+} pool_future_t;
+
+// Each worker owns one of these. It pushes and pops its own tasks at the
+// tail, newest first, while idle workers steal from the head, oldest first.
+typedef struct pool_deque
+{
+    pthread_mutex_t lock;
+    pool_future_t **tasks;
+    size_t head;
+    size_t count;
+    size_t capacity;
+} pool_deque_t;
+
+struct pool_worker;
+
+// A fixed set of worker threads with a work-stealing deque each. Tasks
+// submitted from a worker go on its own deque, others are dealt out round
+// robin. Waiting on a future runs queued tasks in the meantime, so tasks
+// can submit and wait on tasks of their own.
+typedef struct pool
+{
+    size_t nthreads;
+    struct pool_worker *workers;
+    pool_deque_t *deques;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    size_t queued;
+    size_t next_deque;
+    bool stopping;
+} pool_t;
+
+#define POOL_WAIT(__pool, __future, __type) (*(__type *)pool_wait((__pool), (__future)))
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+pool_t *pool_create(size_t nthreads);
+pool_future_t *pool_submit(pool_t *pool, pool_task_t task, void *ctx, size_t result_size);
+void *pool_wait(pool_t *pool, pool_future_t *future);
+void pool_future_free(pool_future_t *future);
+bool pool_reduce(pool_t *pool, size_t count, size_t nchunks, pool_map_t map, pool_merge_t merge, void *ctx, void *result, size_t result_size);
+void pool_free(pool_t *pool);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
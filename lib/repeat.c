@@ -0,0 +1,175 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils.h"
+#include "intmap.h"
+#include "sort.h"
+#include "repeat.h"
+
+// The running totals are f(0) = 0 and f(t + 1) = f(t) + deltas[t % n]. With
+// p[i] = f(i) for one cycle and the drift D = f(n), every later total is
+// f(k * n + i) = p[i] + k * D.
+
+typedef struct repeat_entry
+{
+    int64_t residue;
+    int64_t value;
+    size_t index;
+} repeat_entry_t;
+
+static int repeat_entry_cmp(const void *a, const void *b, void *ctx)
+{
+    const repeat_entry_t *e1 = a;
+    const repeat_entry_t *e2 = b;
+    if (e1->residue != e2->residue) {
+        return (e1->residue < e2->residue) ? -1 : 1;
+    } else if (e1->value != e2->value) {
+        return (e1->value < e2->value) ? -1 : 1;
+    } else {
+        return (e1->index < e2->index) ? -1 : (e1->index > e2->index);
+    }
+}
+
+static int64_t repeat_abs(int64_t value)
+{
+    return (value < 0) ? -value : value;
+}
+
+// p[j] = p[i] + m * D can only be hit again after m cycles, at time
+// m * n + i, and for a given i the smallest m comes from the next value
+// after p[i] (in the direction of D) among the totals congruent to it mod
+// D. So sorting the first cycle by (p mod D, p) and looking at neighbours
+// finds the first repeat in O(n log n) without simulating anything.
+static bool repeat_analytic(const int64_t *deltas, size_t n, int64_t drift, int64_t *result)
+{
+    repeat_entry_t *entries = malloc(n * sizeof(repeat_entry_t));
+    DIE_IF((entries == NULL), "Could not allocate %zu totals", n);
+
+    int64_t modulus = repeat_abs(drift);
+    int64_t total = 0;
+    for (size_t i = 0; i < n; ++i) {
+        entries[i].residue = ((total % modulus) + modulus) % modulus;
+        entries[i].value = total;
+        entries[i].index = i;
+        total += deltas[i];
+    }
+    sort_merge(entries, n, sizeof(entries[0]), repeat_entry_cmp, NULL, 0);
+
+    bool found = false;
+    unsigned __int128 best = 0;
+    for (size_t k = 1; k < n; ++k) {
+        repeat_entry_t *lo = &entries[k - 1];
+        repeat_entry_t *hi = &entries[k];
+        if (lo->residue != hi->residue) {
+            continue;
+        }
+
+        // A total repeated inside the first cycle beats anything later.
+        unsigned __int128 when = 0;
+        int64_t value = 0;
+        if (lo->value == hi->value) {
+            when = hi->index;
+            value = hi->value;
+        } else if (drift > 0) {
+            when = ((unsigned __int128)((hi->value - lo->value) / modulus) * n) + lo->index;
+            value = hi->value;
+        } else {
+            when = ((unsigned __int128)((hi->value - lo->value) / modulus) * n) + hi->index;
+            value = lo->value;
+        }
+
+        if (!found || when < best) {
+            found = true;
+            best = when;
+            *result = value;
+        }
+    }
+
+    free(entries);
+    return found;
+}
+
+// Walks the totals, remembering each one. Any repeat happens within
+// range / |D| + 1 cycles, which also bounds the totals that can be seen, so
+// a dense bitset is used when that range fits the budget.
+static bool repeat_simulate(const int64_t *deltas, size_t n, int64_t drift, int64_t *result)
+{
+    int64_t lo = 0, hi = 0, total = 0;
+    for (size_t i = 0; i < n; ++i) {
+        total += deltas[i];
+        lo = (total < lo) ? total : lo;
+        hi = (total > hi) ? total : hi;
+    }
+
+    uint64_t cycles = 1;
+    if (drift != 0) {
+        cycles = ((uint64_t)(hi - lo) / repeat_abs(drift)) + 2;
+        int64_t reach = (int64_t)cycles * drift;
+        lo += (reach < 0) ? reach : 0;
+        hi += (reach > 0) ? reach : 0;
+    }
+
+    uint64_t bits = (uint64_t)(hi - lo) + 1;
+    uint64_t *bitset = NULL;
+    intmap_t *set = NULL;
+    if (bits <= REPEAT_BITSET_MAX_BITS) {
+        bitset = calloc((bits + 63) / 64, sizeof(uint64_t));
+    }
+    if (bitset == NULL) {
+        set = intmap_create(n);
+        DIE_IF((set == NULL), "Could not allocate a set for %zu totals", n);
+    }
+
+    bool found = false;
+    total = 0;
+    for (uint64_t c = 0; !found && c <= cycles; ++c) {
+        for (size_t i = 0; i < n; ++i) {
+            bool seen = false;
+            if (bitset) {
+                uint64_t bit = (uint64_t)(total - lo);
+                uint64_t mask = 1ULL << (bit % 64);
+                seen = (bitset[bit / 64] & mask) != 0;
+                bitset[bit / 64] |= mask;
+            } else {
+                intmap_insert(set, total, 0, &seen);
+            }
+
+            if (seen) {
+                *result = total;
+                found = true;
+                break;
+            }
+            total += deltas[i];
+        }
+    }
+
+    free(bitset);
+    intmap_free(set);
+    return found;
+}
+
+// Finds the first running total (starting from, and counting, 0) that comes
+// up twice when deltas is applied over and over. Returns false if none ever
+// does.
+bool repeat_find_first(const int64_t *deltas, size_t n, repeat_mode_t mode, int64_t *result)
+{
+    if (n == 0) {
+        *result = 0;
+        return true;
+    }
+
+    int64_t drift = 0;
+    for (size_t i = 0; i < n; ++i) {
+        drift += deltas[i];
+    }
+
+    // With no drift the totals come back to 0 after one cycle, so there is
+    // nothing for the analytic mode to skip.
+    if (mode == REPEAT_ANALYTIC || (mode == REPEAT_AUTO && drift != 0)) {
+        if (drift != 0) {
+            return repeat_analytic(deltas, n, drift, result);
+        }
+    }
+    return repeat_simulate(deltas, n, drift, result);
+}
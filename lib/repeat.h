@@ -0,0 +1,32 @@
+#ifndef REPEAT_H
+#define REPEAT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Largest value range the simulation tracks with a dense bitset (128MiB);
+// anything wider falls back to a hash set.
+#define REPEAT_BITSET_MAX_BITS (1ULL << 30)
+
+typedef enum
+{
+    // Analytic when the totals drift, simulation otherwise
+    REPEAT_AUTO = 0,
+    // Step through the cycles remembering every total seen
+    REPEAT_SIMULATE,
+    // Work the answer out from the first cycle and the drift
+    REPEAT_ANALYTIC,
+} repeat_mode_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+bool repeat_find_first(const int64_t *deltas, size_t n, repeat_mode_t mode, int64_t *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
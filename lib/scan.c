@@ -0,0 +1,116 @@
+#include <stdint.h>
+
+#include "cpu.h"
+#include "scan.h"
+
+size_t scan_newlines_scalar(const char *buf, size_t len, size_t *positions, size_t max, size_t *scanned)
+{
+    size_t count = 0;
+    size_t i = 0;
+    for (; i < len && count < max; ++i) {
+        if (buf[i] == '\n') {
+            positions[count++] = i;
+        }
+    }
+
+    *scanned = i;
+    return count;
+}
+
+#ifdef CPU_X86
+
+// Finishes the last partial block of a vector scan one byte at a time.
+static inline size_t scan_newlines_tail(const char *buf, size_t len, size_t i, size_t *positions, size_t count, size_t max, size_t *scanned)
+{
+    for (; i < len && count < max; ++i) {
+        if (buf[i] == '\n') {
+            positions[count++] = i;
+        }
+    }
+
+    *scanned = i;
+    return count;
+}
+
+// Turns a compare mask into positions, lowest bit first.
+#define SCAN_EMIT_MASK(__mask, __base, __positions, __count) \
+    while (__mask) { \
+        (__positions)[(__count)++] = (__base) + __builtin_ctz(__mask); \
+        __mask &= (__mask) - 1; \
+    }
+
+__attribute__((target("sse2")))
+size_t scan_newlines_sse2(const char *buf, size_t len, size_t *positions, size_t max, size_t *scanned)
+{
+    const __m128i newline = _mm_set1_epi8('\n');
+    size_t count = 0;
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        if (max - count < 32) {
+            *scanned = i;
+            return count;
+        }
+        __m128i lo = _mm_loadu_si128((const __m128i *)(buf + i));
+        __m128i hi = _mm_loadu_si128((const __m128i *)(buf + i + 16));
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(lo, newline));
+        mask |= (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(hi, newline)) << 16;
+        SCAN_EMIT_MASK(mask, i, positions, count);
+    }
+
+    return scan_newlines_tail(buf, len, i, positions, count, max, scanned);
+}
+
+__attribute__((target("avx2")))
+size_t scan_newlines_avx2(const char *buf, size_t len, size_t *positions, size_t max, size_t *scanned)
+{
+    const __m256i newline = _mm256_set1_epi8('\n');
+    size_t count = 0;
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        if (max - count < 32) {
+            *scanned = i;
+            return count;
+        }
+        __m256i v = _mm256_loadu_si256((const __m256i *)(buf + i));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, newline));
+        SCAN_EMIT_MASK(mask, i, positions, count);
+    }
+
+    return scan_newlines_tail(buf, len, i, positions, count, max, scanned);
+}
+
+#else
+
+size_t scan_newlines_sse2(const char *buf, size_t len, size_t *positions, size_t max, size_t *scanned)
+{
+    return scan_newlines_scalar(buf, len, positions, max, scanned);
+}
+
+size_t scan_newlines_avx2(const char *buf, size_t len, size_t *positions, size_t max, size_t *scanned)
+{
+    return scan_newlines_scalar(buf, len, positions, max, scanned);
+}
+
+#endif
+
+scan_newlines_t scan_newlines_select(void)
+{
+    if (cpu_has_avx2()) {
+        return scan_newlines_avx2;
+    } else if (cpu_has_sse2()) {
+        return scan_newlines_sse2;
+    } else {
+        return scan_newlines_scalar;
+    }
+}
+
+size_t scan_newlines(const char *buf, size_t len, size_t *positions, size_t max, size_t *scanned)
+{
+    static scan_newlines_t impl = NULL;
+    scan_newlines_t fn = __atomic_load_n(&impl, __ATOMIC_RELAXED);
+    if (fn == NULL) {
+        fn = scan_newlines_select();
+        __atomic_store_n(&impl, fn, __ATOMIC_RELAXED);
+    }
+    return fn(buf, len, positions, max, scanned);
+}
@@ -0,0 +1,30 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stddef.h>
+
+// The vector kernels never start a block unless it fits in what's left of
+// positions, so callers must always pass at least this many slots.
+#define SCAN_BLOCK_MAX (32)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Stores the offsets of the newlines in buf[0, len) into positions, stopping
+// early if positions (max entries) runs out of room. Returns the number of
+// newlines stored; *scanned is how many bytes of buf were covered, so the
+// caller resumes at buf + *scanned.
+typedef size_t (*scan_newlines_t)(const char *buf, size_t len, size_t *positions, size_t max, size_t *scanned);
+
+size_t scan_newlines(const char *buf, size_t len, size_t *positions, size_t max, size_t *scanned);
+size_t scan_newlines_scalar(const char *buf, size_t len, size_t *positions, size_t max, size_t *scanned);
+size_t scan_newlines_sse2(const char *buf, size_t len, size_t *positions, size_t max, size_t *scanned);
+size_t scan_newlines_avx2(const char *buf, size_t len, size_t *positions, size_t max, size_t *scanned);
+scan_newlines_t scan_newlines_select(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
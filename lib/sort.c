@@ -0,0 +1,237 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "utils.h"
+#include "parallel.h"
+#include "sort.h"
+
+// Both sorts are stable: equal elements keep their input order, so the
+// result doesn't depend on the thread count.
+
+#define SORT_AT(__base, __i, __size) ((char *)(__base) + ((__i) * (__size)))
+
+static inline void sort_copy(void *dst, const void *src, size_t size)
+{
+    // Pointer and integer arrays are the common case; give the compiler a
+    // constant size for them.
+    switch (size) {
+        case sizeof(uint64_t):
+            memcpy(dst, src, sizeof(uint64_t));
+            break;
+        case sizeof(uint32_t):
+            memcpy(dst, src, sizeof(uint32_t));
+            break;
+        default:
+            memcpy(dst, src, size);
+            break;
+    }
+}
+
+static void sort_insertion(char *base, size_t n, size_t size, sort_cmp_t cmp, void *ctx, char *scratch)
+{
+    for (size_t i = 1; i < n; ++i) {
+        size_t j = i;
+        sort_copy(scratch, SORT_AT(base, i, size), size);
+        while (j > 0 && cmp(SORT_AT(base, j - 1, size), scratch, ctx) > 0) {
+            sort_copy(SORT_AT(base, j, size), SORT_AT(base, j - 1, size), size);
+            j--;
+        }
+        sort_copy(SORT_AT(base, j, size), scratch, size);
+    }
+}
+
+// Merges the sorted runs src[0, mid) and src[mid, n) into dst.
+static void sort_merge_runs(char *dst, const char *src, size_t mid, size_t n, size_t size, sort_cmp_t cmp, void *ctx)
+{
+    size_t i = 0, j = mid, k = 0;
+    while (i < mid && j < n) {
+        // Take from the right only if strictly smaller, to stay stable.
+        if (cmp(SORT_AT(src, j, size), SORT_AT(src, i, size), ctx) < 0) {
+            sort_copy(SORT_AT(dst, k++, size), SORT_AT(src, j++, size), size);
+        } else {
+            sort_copy(SORT_AT(dst, k++, size), SORT_AT(src, i++, size), size);
+        }
+    }
+    memcpy(SORT_AT(dst, k, size), SORT_AT(src, i, size), (mid - i) * size);
+    k += mid - i;
+    memcpy(SORT_AT(dst, k, size), SORT_AT(src, j, size), (n - j) * size);
+}
+
+// Sorts base[0, n) using tmp (same size) as scratch. The result ends up in
+// base.
+static void sort_merge_serial(char *base, char *tmp, size_t n, size_t size, sort_cmp_t cmp, void *ctx)
+{
+    char scratch[size];
+    for (size_t i = 0; i < n; i += SORT_INSERTION_MAX) {
+        size_t len = (n - i < SORT_INSERTION_MAX) ? (n - i) : SORT_INSERTION_MAX;
+        sort_insertion(SORT_AT(base, i, size), len, size, cmp, ctx, scratch);
+    }
+
+    // Bottom-up merge passes, ping-ponging between base and tmp.
+    char *src = base, *dst = tmp;
+    for (size_t width = SORT_INSERTION_MAX; width < n; width *= 2) {
+        for (size_t i = 0; i < n; i += 2 * width) {
+            size_t mid = (i + width < n) ? (i + width) : n;
+            size_t end = (i + 2 * width < n) ? (i + 2 * width) : n;
+            sort_merge_runs(SORT_AT(dst, i, size), SORT_AT(src, i, size), mid - i, end - i, size, cmp, ctx);
+        }
+        char *swap = src;
+        src = dst;
+        dst = swap;
+    }
+
+    if (src != base) {
+        memcpy(base, src, n * size);
+    }
+}
+
+typedef struct sort_job
+{
+    char *base;
+    char *tmp;
+    size_t size;
+    sort_cmp_t cmp;
+    void *ctx;
+    size_t nruns;
+    size_t *bounds;
+    size_t width;
+} sort_job_t;
+
+static void sort_run_task(void *arg, size_t index, size_t count)
+{
+    sort_job_t *job = arg;
+    size_t begin = job->bounds[index];
+    size_t n = job->bounds[index + 1] - begin;
+    sort_merge_serial(SORT_AT(job->base, begin, job->size), SORT_AT(job->tmp, begin, job->size), n, job->size, job->cmp, job->ctx);
+}
+
+// Merges runs (2 * index) and (2 * index + 1) of the current round from
+// base into tmp.
+static void sort_pair_task(void *arg, size_t index, size_t count)
+{
+    sort_job_t *job = arg;
+    size_t first = 2 * index * job->width;
+    size_t nruns = job->nruns;
+    size_t begin = job->bounds[first];
+    size_t mid = job->bounds[(first + job->width < nruns) ? (first + job->width) : nruns];
+    size_t end = job->bounds[(first + 2 * job->width < nruns) ? (first + 2 * job->width) : nruns];
+    sort_merge_runs(SORT_AT(job->tmp, begin, job->size), SORT_AT(job->base, begin, job->size), mid - begin, end - begin, job->size, job->cmp, job->ctx);
+}
+
+// Stable merge sort. The array is cut into one run per thread, the runs are
+// sorted concurrently and then merged pairwise, each round of merges also
+// running concurrently. threads == 0 picks one per online CPU.
+void sort_merge(void *base, size_t n, size_t size, sort_cmp_t cmp, void *ctx, size_t threads)
+{
+    if (n < 2) {
+        return;
+    }
+
+    char *tmp = malloc(n * size);
+    DIE_IF((tmp == NULL), "Could not allocate %zu bytes to sort", n * size);
+
+    if (threads == 0) {
+        threads = parallel_default_threads();
+    }
+    if (n < SORT_PARALLEL_MIN || threads < 2) {
+        sort_merge_serial(base, tmp, n, size, cmp, ctx);
+        free(tmp);
+        return;
+    }
+
+    size_t *bounds = calloc(threads + 1, sizeof(size_t));
+    DIE_IF((bounds == NULL), "Could not allocate sort runs");
+    for (size_t t = 0; t <= threads; ++t) {
+        bounds[t] = ((n / threads) * t) + ((t < (n % threads)) ? t : (n % threads));
+    }
+
+    sort_job_t job = { base, tmp, size, cmp, ctx, threads, bounds, 0 };
+    parallel_for(threads, sort_run_task, &job);
+
+    char *src = base, *dst = tmp;
+    for (size_t width = 1; width < threads; width *= 2) {
+        job.base = src;
+        job.tmp = dst;
+        job.width = width;
+        size_t pairs = (threads + (2 * width) - 1) / (2 * width);
+        parallel_for(pairs, sort_pair_task, &job);
+        char *swap = src;
+        src = dst;
+        dst = swap;
+    }
+
+    if (src != base) {
+        memcpy(base, src, n * size);
+    }
+    free(bounds);
+    free(tmp);
+}
+
+typedef struct sort_pair
+{
+    uint64_t key;
+    size_t index;
+} sort_pair_t;
+
+// Stable LSD radix sort on 64-bit keys pulled out by key(). Keys are
+// extracted once, (key, index) pairs are sorted a byte at a time (bytes
+// that are the same in every key are skipped), and the elements are then
+// moved into place in one gather.
+void sort_radix(void *base, size_t n, size_t size, sort_key_t key, void *ctx)
+{
+    if (n < 2) {
+        return;
+    }
+
+    sort_pair_t *pairs = malloc(n * sizeof(sort_pair_t));
+    sort_pair_t *tmp = malloc(n * sizeof(sort_pair_t));
+    size_t (*counts)[256] = calloc(8, sizeof(*counts));
+    DIE_IF((pairs == NULL || tmp == NULL || counts == NULL), "Could not allocate radix sort buffers for %zu elements", n);
+
+    uint64_t all_or = 0, all_and = ~0ULL;
+    for (size_t i = 0; i < n; ++i) {
+        uint64_t k = key(SORT_AT(base, i, size), ctx);
+        pairs[i].key = k;
+        pairs[i].index = i;
+        all_or |= k;
+        all_and &= k;
+        for (unsigned b = 0; b < 8; ++b) {
+            counts[b][(k >> (8 * b)) & 0xFF]++;
+        }
+    }
+
+    uint64_t varying = all_or ^ all_and;
+    for (unsigned b = 0; b < 8; ++b) {
+        unsigned shift = 8 * b;
+        if (((varying >> shift) & 0xFF) == 0) {
+            continue;
+        }
+
+        size_t offset = 0;
+        for (unsigned d = 0; d < 256; ++d) {
+            size_t c = counts[b][d];
+            counts[b][d] = offset;
+            offset += c;
+        }
+        for (size_t i = 0; i < n; ++i) {
+            tmp[counts[b][(pairs[i].key >> shift) & 0xFF]++] = pairs[i];
+        }
+        sort_pair_t *swap = pairs;
+        pairs = tmp;
+        tmp = swap;
+    }
+
+    char *sorted = malloc(n * size);
+    DIE_IF((sorted == NULL), "Could not allocate %zu bytes to sort", n * size);
+    for (size_t i = 0; i < n; ++i) {
+        sort_copy(SORT_AT(sorted, i, size), SORT_AT(base, pairs[i].index, size), size);
+    }
+    memcpy(base, sorted, n * size);
+
+    free(sorted);
+    free(counts);
+    free(tmp);
+    free(pairs);
+}
@@ -0,0 +1,35 @@
+#ifndef SORT_H
+#define SORT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Arrays shorter than this are sorted on the calling thread only.
+#define SORT_PARALLEL_MIN (64 * 1024)
+
+// Runs shorter than this are insertion sorted before merging.
+#define SORT_INSERTION_MAX (16)
+
+typedef int (*sort_cmp_t)(const void *a, const void *b, void *ctx);
+
+// Radix keys are compared as unsigned integers, so signed keys need their
+// sign bit flipped (see sort_key_from_signed()).
+typedef uint64_t (*sort_key_t)(const void *elem, void *ctx);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+static inline uint64_t sort_key_from_signed(int64_t value)
+{
+    return ((uint64_t)value) ^ (1ULL << 63);
+}
+
+void sort_merge(void *base, size_t n, size_t size, sort_cmp_t cmp, void *ctx, size_t threads);
+void sort_radix(void *base, size_t n, size_t size, sort_key_t key, void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
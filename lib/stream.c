@@ -0,0 +1,126 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+
+#include "utils.h"
+#include "stream.h"
+
+stream_t *stream_open(const char *filename, size_t chunk_size)
+{
+    stream_t *stream = calloc(1, sizeof(stream_t));
+    VALIDATE_PTR_OR_RETURN(stream, NULL);
+
+    stream->fd = open(filename, O_RDONLY);
+    if (stream->fd < 0) {
+        free(stream);
+        return NULL;
+    }
+    posix_fadvise(stream->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    // One spare byte so the last line can always be NUL-terminated.
+    stream->chunk_size = chunk_size ? chunk_size : STREAM_DEFAULT_CHUNK_SIZE;
+    stream->bufsize = stream->chunk_size + 1;
+    stream->buf = malloc(stream->bufsize);
+    if (stream->buf == NULL) {
+        stream_close(stream);
+        return NULL;
+    }
+    return stream;
+}
+
+// Moves whatever hasn't been handed out yet to the front of the buffer and
+// reads up to another chunk after it. A line that doesn't fit in the buffer
+// doubles it, so lines may be longer than the chunk size.
+static bool stream_fill(stream_t *stream)
+{
+    if (stream->eof) {
+        return false;
+    }
+
+    if (stream->start > 0) {
+        size_t pending = stream->end - stream->start;
+        memmove(stream->buf, stream->buf + stream->start, pending);
+        stream->scanned -= stream->start;
+        stream->end = pending;
+        stream->start = 0;
+    }
+
+    if ((stream->bufsize - 1 - stream->end) == 0) {
+        size_t new_size = 2 * (stream->bufsize - 1) + 1;
+        char *buf = realloc(stream->buf, new_size);
+        DIE_IF((buf == NULL), "Could not grow stream buffer to %zu bytes", new_size);
+        stream->buf = buf;
+        stream->bufsize = new_size;
+    }
+
+    size_t room = stream->bufsize - 1 - stream->end;
+    if (room > stream->chunk_size) {
+        room = stream->chunk_size;
+    }
+
+    ssize_t bytes_read = 0;
+    do {
+        bytes_read = read(stream->fd, stream->buf + stream->end, room);
+    } while (bytes_read < 0 && errno == EINTR);
+
+    if (bytes_read <= 0) {
+        if (bytes_read < 0) {
+            ERR("Read failed: %s", strerror(errno));
+        }
+        stream->eof = true;
+        return false;
+    }
+
+    stream->end += bytes_read;
+    return true;
+}
+
+// Hands out the next line with its newline stripped. The string points into
+// the stream's buffer and is only valid until the next call.
+bool stream_next_line(stream_t *stream, line_t *line)
+{
+    for (;;) {
+        char *base = stream->buf + stream->start;
+        char *from = stream->buf + stream->scanned;
+        char *newline = memchr(from, '\n', stream->end - stream->scanned);
+        if (newline) {
+            *newline = '\0';
+            line->str = base;
+            line->len = newline - base;
+            line->extra = NULL;
+            stream->start = stream->scanned = (newline - stream->buf) + 1;
+            return true;
+        }
+
+        stream->scanned = stream->end;
+        if (!stream_fill(stream)) {
+            break;
+        }
+    }
+
+    // Last line without a trailing newline
+    if (stream->start < stream->end) {
+        stream->buf[stream->end] = '\0';
+        line->str = stream->buf + stream->start;
+        line->len = stream->end - stream->start;
+        line->extra = NULL;
+        stream->start = stream->scanned = stream->end;
+        return true;
+    }
+
+    return false;
+}
+
+void stream_close(stream_t *stream)
+{
+    if (stream) {
+        if (stream->fd >= 0) {
+            close(stream->fd);
+        }
+        free(stream->buf);
+        free(stream);
+    }
+}
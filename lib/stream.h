@@ -0,0 +1,38 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "file.h"
+
+#define STREAM_DEFAULT_CHUNK_SIZE (1024 * 1024)
+
+// Reads a file a chunk at a time so a pass over it only ever holds one
+// chunk (plus the longest line) in memory, however large the input is.
+typedef struct stream
+{
+    int fd;
+    char *buf;
+    size_t bufsize;
+    size_t chunk_size;
+    size_t start;
+    size_t scanned;
+    size_t end;
+    bool eof;
+} stream_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+stream_t *stream_open(const char *filename, size_t chunk_size);
+bool stream_next_line(stream_t *stream, line_t *line);
+void stream_close(stream_t *stream);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
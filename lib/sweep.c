@@ -0,0 +1,259 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils.h"
+#include "sort.h"
+#include "sweep.h"
+
+// Removals sort ahead of insertions at the same x, since rectangles are
+// half-open and one ending where another starts doesn't overlap it.
+#define SWEEP_EVENT_REMOVE (0)
+#define SWEEP_EVENT_INSERT (1)
+
+typedef struct sweep_event
+{
+    uint64_t key;
+    uint32_t rect;
+} sweep_event_t;
+
+// Leaf i of the tree is the y interval [ys[i], ys[i + 1]).
+typedef struct sweep_tree
+{
+    sweep_node_t *nodes;
+    const uint64_t *ys;
+    size_t leaves;
+} sweep_tree_t;
+
+static uint64_t sweep_event_key(const void *elem, void *ctx)
+{
+    return ((const sweep_event_t *)elem)->key;
+}
+
+static uint64_t sweep_y_key(const void *elem, void *ctx)
+{
+    return *(const uint64_t *)elem;
+}
+
+static uint64_t sweep_max(uint64_t a, uint64_t b)
+{
+    return (a > b) ? a : b;
+}
+
+// Recomputes a node from its own count and its children. Counts are never
+// pushed down, so a node's count only says something about its own range.
+static void sweep_pull(sweep_tree_t *tree, size_t node, size_t lo, size_t hi)
+{
+    sweep_node_t *n = &tree->nodes[node];
+    uint64_t length = tree->ys[hi] - tree->ys[lo];
+    uint64_t below1 = 0, below2 = 0;
+    uint32_t below_max = 0;
+    if (hi - lo > 1) {
+        sweep_node_t *left = &tree->nodes[2 * node];
+        sweep_node_t *right = &tree->nodes[(2 * node) + 1];
+        below1 = left->covered1 + right->covered1;
+        below2 = left->covered2 + right->covered2;
+        below_max = (uint32_t)sweep_max(left->max_count, right->max_count);
+    }
+
+    if (n->count >= 2) {
+        n->covered1 = length;
+        n->covered2 = length;
+    } else if (n->count == 1) {
+        n->covered1 = length;
+        n->covered2 = below1;
+    } else {
+        n->covered1 = below1;
+        n->covered2 = below2;
+    }
+    n->max_count = n->count + below_max;
+}
+
+static void sweep_add(sweep_tree_t *tree, size_t node, size_t lo, size_t hi, size_t a, size_t b, int delta)
+{
+    if (b <= lo || hi <= a) {
+        return;
+    }
+
+    if (a <= lo && hi <= b) {
+        tree->nodes[node].count += delta;
+    } else {
+        size_t mid = lo + ((hi - lo) / 2);
+        sweep_add(tree, 2 * node, lo, mid, a, b, delta);
+        sweep_add(tree, (2 * node) + 1, mid, hi, a, b, delta);
+    }
+    sweep_pull(tree, node, lo, hi);
+}
+
+static uint32_t sweep_max_count(sweep_tree_t *tree, size_t node, size_t lo, size_t hi, size_t a, size_t b)
+{
+    if (b <= lo || hi <= a) {
+        return 0;
+    }
+
+    sweep_node_t *n = &tree->nodes[node];
+    if (a <= lo && hi <= b) {
+        return n->max_count;
+    }
+
+    size_t mid = lo + ((hi - lo) / 2);
+    uint32_t left = sweep_max_count(tree, 2 * node, lo, mid, a, b);
+    uint32_t right = sweep_max_count(tree, (2 * node) + 1, mid, hi, a, b);
+    return n->count + (uint32_t)sweep_max(left, right);
+}
+
+// Stamps only ever increase, so marking a range is a plain overwrite.
+static void sweep_stamp(sweep_tree_t *tree, size_t node, size_t lo, size_t hi, size_t a, size_t b, uint32_t stamp)
+{
+    if (b <= lo || hi <= a) {
+        return;
+    }
+
+    sweep_node_t *n = &tree->nodes[node];
+    n->max_stamp = stamp;
+    if (a <= lo && hi <= b) {
+        n->stamp = stamp;
+        return;
+    }
+
+    size_t mid = lo + ((hi - lo) / 2);
+    sweep_stamp(tree, 2 * node, lo, mid, a, b, stamp);
+    sweep_stamp(tree, (2 * node) + 1, mid, hi, a, b, stamp);
+}
+
+static uint32_t sweep_max_stamp(sweep_tree_t *tree, size_t node, size_t lo, size_t hi, size_t a, size_t b)
+{
+    if (b <= lo || hi <= a) {
+        return 0;
+    }
+
+    sweep_node_t *n = &tree->nodes[node];
+    if (a <= lo && hi <= b) {
+        return n->max_stamp;
+    }
+
+    size_t mid = lo + ((hi - lo) / 2);
+    uint32_t left = sweep_max_stamp(tree, 2 * node, lo, mid, a, b);
+    uint32_t right = sweep_max_stamp(tree, (2 * node) + 1, mid, hi, a, b);
+    return (uint32_t)sweep_max(n->stamp, sweep_max(left, right));
+}
+
+static size_t sweep_y_index(const uint64_t *ys, size_t count, uint64_t y)
+{
+    size_t lo = 0, hi = count;
+    while (lo < hi) {
+        size_t mid = lo + ((hi - lo) / 2);
+        if (ys[mid] < y) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// Returns the area covered by two or more rectangles. If overlapped isn't
+// NULL, overlapped[i] is set to whether rectangle i shares any area with
+// another one.
+//
+// Two rectangles overlap exactly when one is inserted while the other is
+// still in the sweep, with intersecting y ranges. The later one sees that
+// as existing coverage over its range when it goes in. The earlier one
+// finds out when it leaves: every insertion stamps its y range with an
+// increasing sequence number, so any stamp newer than its own over its
+// range means something arrived on top of it.
+uint64_t sweep_overlap(const uint32_t *x, const uint32_t *y, const uint32_t *width, const uint32_t *height, size_t n, bool *overlapped)
+{
+    if (overlapped) {
+        memset(overlapped, 0, n * sizeof(bool));
+    }
+
+    // Empty rectangles cover nothing and so can't overlap anything.
+    size_t nrects = 0;
+    for (size_t i = 0; i < n; ++i) {
+        nrects += (width[i] != 0 && height[i] != 0);
+    }
+    if (nrects == 0) {
+        return 0;
+    }
+    DIE_IF((nrects > UINT32_MAX - 1), "Too many rectangles (%zu) to sweep", nrects);
+
+    uint64_t *ys = malloc(2 * nrects * sizeof(uint64_t));
+    sweep_event_t *events = malloc(2 * nrects * sizeof(sweep_event_t));
+    size_t *y_range = malloc(2 * n * sizeof(size_t));
+    uint32_t *stamps = malloc(n * sizeof(uint32_t));
+    DIE_IF((ys == NULL || events == NULL || y_range == NULL || stamps == NULL), "Could not allocate sweep for %zu rectangles", n);
+
+    size_t nevents = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (width[i] == 0 || height[i] == 0) {
+            continue;
+        }
+        ys[nevents] = y[i];
+        ys[nevents + 1] = (uint64_t)y[i] + height[i];
+        events[nevents].key = ((uint64_t)x[i] << 1) | SWEEP_EVENT_INSERT;
+        events[nevents].rect = (uint32_t)i;
+        events[nevents + 1].key = (((uint64_t)x[i] + width[i]) << 1) | SWEEP_EVENT_REMOVE;
+        events[nevents + 1].rect = (uint32_t)i;
+        nevents += 2;
+    }
+
+    sort_radix(ys, nevents, sizeof(ys[0]), sweep_y_key, NULL);
+    size_t nys = 1;
+    for (size_t i = 1; i < nevents; ++i) {
+        if (ys[i] != ys[nys - 1]) {
+            ys[nys++] = ys[i];
+        }
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        if (width[i] != 0 && height[i] != 0) {
+            y_range[2 * i] = sweep_y_index(ys, nys, y[i]);
+            y_range[(2 * i) + 1] = sweep_y_index(ys, nys, (uint64_t)y[i] + height[i]);
+        }
+    }
+
+    sweep_tree_t tree = {
+        .nodes = calloc(4 * nys, sizeof(sweep_node_t)),
+        .ys = ys,
+        .leaves = nys - 1,
+    };
+    DIE_IF((tree.nodes == NULL), "Could not allocate sweep tree for %zu coordinates", nys);
+
+    sort_radix(events, nevents, sizeof(events[0]), sweep_event_key, NULL);
+
+    uint64_t area = 0;
+    uint64_t last_x = events[0].key >> 1;
+    uint32_t stamp = 0;
+    for (size_t e = 0; e < nevents; ++e) {
+        uint64_t event_x = events[e].key >> 1;
+        area += tree.nodes[1].covered2 * (event_x - last_x);
+        last_x = event_x;
+
+        uint32_t r = events[e].rect;
+        size_t a = y_range[2 * r];
+        size_t b = y_range[(2 * r) + 1];
+        if ((events[e].key & 1) == SWEEP_EVENT_INSERT) {
+            if (overlapped) {
+                if (sweep_max_count(&tree, 1, 0, tree.leaves, a, b) != 0) {
+                    overlapped[r] = true;
+                }
+                stamps[r] = ++stamp;
+                sweep_stamp(&tree, 1, 0, tree.leaves, a, b, stamps[r]);
+            }
+            sweep_add(&tree, 1, 0, tree.leaves, a, b, 1);
+        } else {
+            sweep_add(&tree, 1, 0, tree.leaves, a, b, -1);
+            if (overlapped && sweep_max_stamp(&tree, 1, 0, tree.leaves, a, b) > stamps[r]) {
+                overlapped[r] = true;
+            }
+        }
+    }
+
+    free(tree.nodes);
+    free(stamps);
+    free(y_range);
+    free(events);
+    free(ys);
+    return area;
+}
@@ -0,0 +1,36 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Rectangle overlap without a dense grid: a sweep along x over a segment
+// tree of the distinct y coordinates, so memory is O(rectangles) however
+// far apart the coordinates are.
+
+typedef struct sweep_node
+{
+    // Rectangles covering this node's whole y range and nothing above it
+    uint32_t count;
+    // Highest coverage anywhere under this node, count included
+    uint32_t max_count;
+    // Lengths covered at least once and at least twice
+    uint64_t covered1;
+    uint64_t covered2;
+    // Latest insertion touching this whole node / anything under it
+    uint32_t stamp;
+    uint32_t max_stamp;
+} sweep_node_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint64_t sweep_overlap(const uint32_t *x, const uint32_t *y, const uint32_t *width, const uint32_t *height, size_t n, bool *overlapped);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,57 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils.h"
+#include "table.h"
+
+table_t *table_create(size_t ncolumns, const size_t *widths)
+{
+    if (ncolumns == 0 || ncolumns > TABLE_MAX_COLUMNS) {
+        ERR("Bad column count %zu", ncolumns);
+        return NULL;
+    }
+
+    table_t *table = calloc(1, sizeof(table_t));
+    VALIDATE_PTR_OR_RETURN(table, NULL);
+    table->ncolumns = ncolumns;
+    memcpy(table->widths, widths, ncolumns * sizeof(widths[0]));
+    if (!table_reserve(table, TABLE_INITIAL_CAPACITY)) {
+        table_free(table);
+        return NULL;
+    }
+    return table;
+}
+
+bool table_reserve(table_t *table, size_t capacity)
+{
+    if (capacity <= table->capacity) {
+        return true;
+    }
+
+    for (size_t c = 0; c < table->ncolumns; ++c) {
+        void *column = realloc(table->columns[c], capacity * table->widths[c]);
+        VALIDATE_PTR_OR_RETURN(column, false);
+        table->columns[c] = column;
+    }
+    table->capacity = capacity;
+    return true;
+}
+
+size_t table_append(table_t *table)
+{
+    if (table->nrows == table->capacity) {
+        DIE_IF(!table_reserve(table, 2 * table->capacity), "Could not grow table to %zu rows", 2 * table->capacity);
+    }
+    return table->nrows++;
+}
+
+void table_free(table_t *table)
+{
+    if (table) {
+        for (size_t c = 0; c < table->ncolumns; ++c) {
+            free(table->columns[c]);
+        }
+        free(table);
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef TABLE_H
+#define TABLE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define TABLE_MAX_COLUMNS (8)
+#define TABLE_INITIAL_CAPACITY (1024)
+
+// A column-major record table: each field of a record lives in its own
+// contiguous array, so a pass over one field streams through memory
+// instead of hopping between heap-allocated structs.
+typedef struct table
+{
+    size_t nrows;
+    size_t capacity;
+    size_t ncolumns;
+    size_t widths[TABLE_MAX_COLUMNS];
+    void *columns[TABLE_MAX_COLUMNS];
+} table_t;
+
+#define TABLE_COLUMN(__t, __type, __col) ((__type *)((__t)->columns[(__col)]))
+#define TABLE_AT(__t, __type, __col, __row) (TABLE_COLUMN(__t, __type, __col)[(__row)])
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+static inline size_t table_row_count(table_t *table)
+{
+    return table->nrows;
+}
+
+table_t *table_create(size_t ncolumns, const size_t *widths);
+bool table_reserve(table_t *table, size_t capacity);
+size_t table_append(table_t *table);
+void table_free(table_t *table);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,258 @@
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "cpu.h"
+#include "text.h"
+
+size_t text_hamming_scalar(const char *s1, const char *s2, size_t len)
+{
+    size_t distance = 0;
+    for (size_t i = 0; i < len; ++i) {
+        distance += (s1[i] != s2[i]);
+    }
+    return distance;
+}
+
+// A plain histogram. Counting across the input with vectors takes a compare
+// per letter per block, which costs more than one increment per byte.
+void text_count_letters(const char *str, size_t len, uint8_t counts[TEXT_LETTER_SLOTS])
+{
+    memset(counts, 0, TEXT_LETTER_SLOTS);
+    for (size_t i = 0; i < len; ++i) {
+        unsigned index = (unsigned char)str[i] - 'a';
+        if (index < TEXT_LETTERS && counts[index] != UINT8_MAX) {
+            counts[index]++;
+        }
+    }
+}
+
+uint32_t text_letters_with_count_scalar(const uint8_t counts[TEXT_LETTER_SLOTS], uint8_t count)
+{
+    uint32_t mask = 0;
+    for (unsigned i = 0; i < TEXT_LETTERS; ++i) {
+        mask |= (uint32_t)(counts[i] == count) << i;
+    }
+    return mask;
+}
+
+// Case is bit 0x20 of an ASCII letter.
+#define TEXT_CASE_BIT (0x20)
+
+// A byte with the case bit cleared never equals the case bit, so that's what
+// the vector kernels compare against when there's no stop letter.
+#define TEXT_CASE_STOP(__stop) (((__stop) != '\0') ? (__stop) : TEXT_CASE_BIT)
+
+static inline bool text_case_stop(const char *str, size_t r, char stop)
+{
+    uint8_t diff = (uint8_t)(str[r] - str[r - 1]);
+    return (diff == TEXT_CASE_BIT) || (diff == (uint8_t)-TEXT_CASE_BIT) || (stop != '\0' && (str[r] & ~TEXT_CASE_BIT) == stop);
+}
+
+size_t text_case_run_scalar(const char *str, size_t len, char stop)
+{
+    size_t r = 1;
+    while (r < len && !text_case_stop(str, r, stop)) {
+        r++;
+    }
+    return (len == 0) ? 0 : r;
+}
+
+#ifdef CPU_X86
+
+#define TEXT_LETTER_MASK ((1U << TEXT_LETTERS) - 1)
+
+__attribute__((target("sse2")))
+size_t text_hamming_sse2(const char *s1, const char *s2, size_t len)
+{
+    size_t same = 0;
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(s1 + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(s2 + i));
+        same += __builtin_popcount((uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)));
+    }
+
+    return (i - same) + text_hamming_scalar(s1 + i, s2 + i, len - i);
+}
+
+__attribute__((target("avx2,popcnt")))
+size_t text_hamming_avx2(const char *s1, const char *s2, size_t len)
+{
+    size_t same = 0;
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(s1 + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(s2 + i));
+        same += __builtin_popcount((uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b)));
+    }
+
+    return (i - same) + text_hamming_scalar(s1 + i, s2 + i, len - i);
+}
+
+__attribute__((target("sse2")))
+uint32_t text_letters_with_count_sse2(const uint8_t counts[TEXT_LETTER_SLOTS], uint8_t count)
+{
+    const __m128i wanted = _mm_set1_epi8((char)count);
+    __m128i lo = _mm_loadu_si128((const __m128i *)counts);
+    __m128i hi = _mm_loadu_si128((const __m128i *)(counts + 16));
+    uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(lo, wanted));
+    mask |= (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(hi, wanted)) << 16;
+    return mask & TEXT_LETTER_MASK;
+}
+
+// Each block is compared against itself shifted back by one byte, so every
+// adjacent pair in it is checked at once; a block with nothing to stop at is
+// skipped whole.
+__attribute__((target("sse2")))
+size_t text_case_run_sse2(const char *str, size_t len, char stop)
+{
+    const __m128i up = _mm_set1_epi8(TEXT_CASE_BIT);
+    const __m128i down = _mm_set1_epi8(-TEXT_CASE_BIT);
+    const __m128i stops = _mm_set1_epi8(TEXT_CASE_STOP(stop));
+    size_t r = 1;
+    for (; r + 32 <= len; r += 32) {
+        __m128i lo = _mm_loadu_si128((const __m128i *)(str + r));
+        __m128i hi = _mm_loadu_si128((const __m128i *)(str + r + 16));
+        __m128i diff_lo = _mm_sub_epi8(lo, _mm_loadu_si128((const __m128i *)(str + r - 1)));
+        __m128i diff_hi = _mm_sub_epi8(hi, _mm_loadu_si128((const __m128i *)(str + r + 15)));
+        __m128i hit_lo = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(diff_lo, up), _mm_cmpeq_epi8(diff_lo, down)), _mm_cmpeq_epi8(_mm_andnot_si128(up, lo), stops));
+        __m128i hit_hi = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(diff_hi, up), _mm_cmpeq_epi8(diff_hi, down)), _mm_cmpeq_epi8(_mm_andnot_si128(up, hi), stops));
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(hit_lo) | ((uint32_t)_mm_movemask_epi8(hit_hi) << 16);
+        if (mask != 0) {
+            return r + __builtin_ctz(mask);
+        }
+    }
+
+    return (len == 0) ? 0 : (r - 1) + text_case_run_scalar(str + r - 1, len - (r - 1), stop);
+}
+
+__attribute__((target("avx2")))
+size_t text_case_run_avx2(const char *str, size_t len, char stop)
+{
+    const __m256i up = _mm256_set1_epi8(TEXT_CASE_BIT);
+    const __m256i down = _mm256_set1_epi8(-TEXT_CASE_BIT);
+    const __m256i stops = _mm256_set1_epi8(TEXT_CASE_STOP(stop));
+    size_t r = 1;
+    for (; r + 64 <= len; r += 64) {
+        __m256i lo = _mm256_loadu_si256((const __m256i *)(str + r));
+        __m256i hi = _mm256_loadu_si256((const __m256i *)(str + r + 32));
+        __m256i diff_lo = _mm256_sub_epi8(lo, _mm256_loadu_si256((const __m256i *)(str + r - 1)));
+        __m256i diff_hi = _mm256_sub_epi8(hi, _mm256_loadu_si256((const __m256i *)(str + r + 31)));
+        __m256i hit_lo = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(diff_lo, up), _mm256_cmpeq_epi8(diff_lo, down)), _mm256_cmpeq_epi8(_mm256_andnot_si256(up, lo), stops));
+        __m256i hit_hi = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(diff_hi, up), _mm256_cmpeq_epi8(diff_hi, down)), _mm256_cmpeq_epi8(_mm256_andnot_si256(up, hi), stops));
+        uint64_t mask = (uint64_t)(uint32_t)_mm256_movemask_epi8(hit_lo) | ((uint64_t)(uint32_t)_mm256_movemask_epi8(hit_hi) << 32);
+        if (mask != 0) {
+            return r + __builtin_ctzll(mask);
+        }
+    }
+
+    return (len == 0) ? 0 : (r - 1) + text_case_run_scalar(str + r - 1, len - (r - 1), stop);
+}
+
+#else
+
+size_t text_hamming_sse2(const char *s1, const char *s2, size_t len)
+{
+    return text_hamming_scalar(s1, s2, len);
+}
+
+size_t text_hamming_avx2(const char *s1, const char *s2, size_t len)
+{
+    return text_hamming_scalar(s1, s2, len);
+}
+
+uint32_t text_letters_with_count_sse2(const uint8_t counts[TEXT_LETTER_SLOTS], uint8_t count)
+{
+    return text_letters_with_count_scalar(counts, count);
+}
+
+size_t text_case_run_sse2(const char *str, size_t len, char stop)
+{
+    return text_case_run_scalar(str, len, stop);
+}
+
+size_t text_case_run_avx2(const char *str, size_t len, char stop)
+{
+    return text_case_run_scalar(str, len, stop);
+}
+
+#endif
+
+text_hamming_t text_hamming_select(void)
+{
+    if (cpu_has_avx2()) {
+        return text_hamming_avx2;
+    } else if (cpu_has_sse2()) {
+        return text_hamming_sse2;
+    } else {
+        return text_hamming_scalar;
+    }
+}
+
+text_letters_with_count_t text_letters_with_count_select(void)
+{
+    if (cpu_has_sse2()) {
+        return text_letters_with_count_sse2;
+    } else {
+        return text_letters_with_count_scalar;
+    }
+}
+
+text_case_run_t text_case_run_select(void)
+{
+    if (cpu_has_avx2()) {
+        return text_case_run_avx2;
+    } else if (cpu_has_sse2()) {
+        return text_case_run_sse2;
+    } else {
+        return text_case_run_scalar;
+    }
+}
+
+size_t text_hamming(const char *s1, const char *s2, size_t len)
+{
+    static text_hamming_t impl = NULL;
+    text_hamming_t fn = __atomic_load_n(&impl, __ATOMIC_RELAXED);
+    if (fn == NULL) {
+        fn = text_hamming_select();
+        __atomic_store_n(&impl, fn, __ATOMIC_RELAXED);
+    }
+    return fn(s1, s2, len);
+}
+
+uint32_t text_letters_with_count(const uint8_t counts[TEXT_LETTER_SLOTS], uint8_t count)
+{
+    static text_letters_with_count_t impl = NULL;
+    text_letters_with_count_t fn = __atomic_load_n(&impl, __ATOMIC_RELAXED);
+    if (fn == NULL) {
+        fn = text_letters_with_count_select();
+        __atomic_store_n(&impl, fn, __ATOMIC_RELAXED);
+    }
+    return fn(counts, count);
+}
+
+size_t text_case_run(const char *str, size_t len, char stop)
+{
+    static text_case_run_t impl = NULL;
+    text_case_run_t fn = __atomic_load_n(&impl, __ATOMIC_RELAXED);
+    if (fn == NULL) {
+        fn = text_case_run_select();
+        __atomic_store_n(&impl, fn, __ATOMIC_RELAXED);
+    }
+    return fn(str, len, stop);
+}
+
+// Copies the bytes s1 and s2 agree on into out, NUL-terminated (out needs
+// len + 1 bytes), and returns the Hamming distance. Only called on the
+// handful of pairs a search turns up, so there's no vector version.
+size_t text_common(const char *s1, const char *s2, size_t len, char *out)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < len; ++i) {
+        out[n] = s1[i];
+        n += (s1[i] == s2[i]);
+    }
+    out[n] = '\0';
+    return len - n;
+}
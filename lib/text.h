@@ -0,0 +1,57 @@
+#ifndef TEXT_H
+#define TEXT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define TEXT_LETTERS (26)
+
+// Letter counts are kept as one byte per letter, padded out to a full AVX2
+// register. Counts saturate at 255.
+#define TEXT_LETTER_SLOTS (32)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Number of positions at which s1[0, len) and s2[0, len) differ
+typedef size_t (*text_hamming_t)(const char *s1, const char *s2, size_t len);
+
+// Bit i of the result is set when letter 'a' + i was counted exactly count
+// times.
+typedef uint32_t (*text_letters_with_count_t)(const uint8_t counts[TEXT_LETTER_SLOTS], uint8_t count);
+
+// Length of the run at the start of str[0, len) that can't hold a reaction:
+// the first r in [1, len) where str[r] is the other case of str[r - 1] (or
+// any two bytes 0x20 apart) or is the letter stop in either case, or len if
+// there's no such r. A stop of '\0' stops at no letter.
+typedef size_t (*text_case_run_t)(const char *str, size_t len, char stop);
+
+size_t text_hamming(const char *s1, const char *s2, size_t len);
+size_t text_hamming_scalar(const char *s1, const char *s2, size_t len);
+size_t text_hamming_sse2(const char *s1, const char *s2, size_t len);
+size_t text_hamming_avx2(const char *s1, const char *s2, size_t len);
+text_hamming_t text_hamming_select(void);
+
+// Counts 'a' to 'z' in str[0, len) into counts[0, TEXT_LETTERS); every other
+// byte is ignored.
+void text_count_letters(const char *str, size_t len, uint8_t counts[TEXT_LETTER_SLOTS]);
+
+uint32_t text_letters_with_count(const uint8_t counts[TEXT_LETTER_SLOTS], uint8_t count);
+uint32_t text_letters_with_count_scalar(const uint8_t counts[TEXT_LETTER_SLOTS], uint8_t count);
+uint32_t text_letters_with_count_sse2(const uint8_t counts[TEXT_LETTER_SLOTS], uint8_t count);
+text_letters_with_count_t text_letters_with_count_select(void);
+
+size_t text_case_run(const char *str, size_t len, char stop);
+size_t text_case_run_scalar(const char *str, size_t len, char stop);
+size_t text_case_run_sse2(const char *str, size_t len, char stop);
+size_t text_case_run_avx2(const char *str, size_t len, char stop);
+text_case_run_t text_case_run_select(void);
+
+size_t text_common(const char *s1, const char *s2, size_t len, char *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif